@@ -2,6 +2,7 @@
 #define __BRICA2_HPP__
 
 #include "brica2/buffer.hpp"
+#include "brica2/view.hpp"
 #include "brica2/component.hpp"
 #include "brica2/executors.hpp"
 #include "brica2/scheduler.hpp"
@@ -2,7 +2,10 @@
 #define __BRICA2_BUFFER_HPP__
 
 #include "brica2/typedef.h"
+#include "brica2/assert.hpp"
 #include "brica2/format.hpp"
+#include "brica2/layout.hpp"
+#include "brica2/memory.hpp"
 #include "brica2/span.hpp"
 
 #include <algorithm>
@@ -11,21 +14,28 @@
 #include <numeric>
 #include <vector>
 
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 
+#ifndef BRICA2_DEFAULT_ALIGNMENT
+#define BRICA2_DEFAULT_ALIGNMENT 64
+#endif  // BRICA2_DEFAULT_ALIGNMENT
+
 namespace brica2 {
+
+constexpr std::size_t default_alignment = BRICA2_DEFAULT_ALIGNMENT;
+
 namespace detail {
 
 enum class byte : unsigned char {};
 
 template <class T, class InputIt>
 auto default_strides(InputIt first, InputIt last) -> decltype(auto) {
-  using value_type = typename std::iterator_traits<InputIt>::value_type;
-  using multiplies = std::multiplies<value_type>;
+  using multiplies = std::multiplies<ssize_t>;
   std::size_t diff = std::distance(first, last);
-  std::vector<value_type> r(diff, sizeof(T));
-  std::copy(first + 1, last, r.begin());
+  extents r(diff, sizeof(T));
+  if (diff != 0) std::copy(std::next(first), last, r.begin());
   std::partial_sum(r.rbegin(), r.rend(), r.rbegin(), multiplies());
   return r;
 }
@@ -34,7 +44,7 @@ template <class InputIt>
 auto product(InputIt first, InputIt last) -> decltype(auto) {
   using value_type = typename std::iterator_traits<InputIt>::value_type;
   using multiplies = std::multiplies<value_type>;
-  return std::accumulate(first, last, 1, multiplies());
+  return std::accumulate(first, last, value_type(1), multiplies());
 }
 
 }  // namespace detail
@@ -46,61 +56,217 @@ class incompatible_exception : public std::exception {
   }
 };
 
-struct buffer_info {
-  ssize_t itemsize;
-  std::string format;
-  ssize_t ndim;
-  std::vector<ssize_t> shape;
-  std::vector<ssize_t> strides;
+struct buffer_info : layout {
   void* ptr;
+  std::size_t alignment;
+  memory_resource* resource;
+  bool read_only;
 };
 
-inline bool compatible(const buffer_info& lhs, const buffer_info& rhs) {
-  return lhs.itemsize == rhs.itemsize && lhs.format == rhs.format &&
-         lhs.ndim == rhs.ndim && lhs.shape == rhs.shape &&
-         lhs.strides == rhs.strides;
+namespace detail {
+
+struct buffer_info_deleter {
+  std::size_t bytes;
+
+  void operator()(buffer_info* p) const {
+    p->resource->deallocate(p->ptr, bytes, p->alignment);
+    resource_allocator<buffer_info> alloc;
+    p->~buffer_info();
+    alloc.deallocate(p, 1);
+  }
+};
+
+struct borrowed_info_deleter {
+  std::shared_ptr<void> owner;
+
+  void operator()(buffer_info* p) const {
+    resource_allocator<buffer_info> alloc;
+    p->~buffer_info();
+    alloc.deallocate(p, 1);
+  }
+};
+
+inline bool valid_alignment(std::size_t alignment) {
+  return alignment != 0 && (alignment & (alignment - 1)) == 0;
 }
 
+inline void strided_copy(
+    const layout& l,
+    const char* src,
+    const extents& src_strides,
+    char* dst,
+    const extents& dst_strides,
+    std::size_t axis) {
+  if (axis == l.shape.size()) {
+    std::memcpy(dst, src, l.itemsize);
+    return;
+  }
+  bool last = axis + 1 == l.shape.size();
+  if (last && src_strides[axis] == l.itemsize &&
+      dst_strides[axis] == l.itemsize) {
+    std::memcpy(dst, src, l.shape[axis] * l.itemsize);
+    return;
+  }
+  for (ssize_t i = 0; i < l.shape[axis]; ++i) {
+    strided_copy(
+        l,
+        src + i * src_strides[axis],
+        src_strides,
+        dst + i * dst_strides[axis],
+        dst_strides,
+        axis + 1);
+  }
+}
+
+// Whether `owner` is referenced only by the caller, following borrowed
+// buffers back to the allocation they view.
+inline bool unique_owner(const std::shared_ptr<void>& owner) {
+  if (owner.use_count() != 1) return false;
+  auto d = std::get_deleter<borrowed_info_deleter>(owner);
+  return d == nullptr || unique_owner(d->owner);
+}
+
+// Largest power of two dividing the address, capped at a page.
+inline std::size_t pointer_alignment(const void* ptr) {
+  auto address = reinterpret_cast<std::uintptr_t>(ptr);
+  std::size_t alignment = 1;
+  while (alignment < 4096 && (address & alignment) == 0) alignment <<= 1;
+  return alignment;
+}
+
+// Allocates the buffer_info and its shared_ptr control block from the info
+// pool and the payload from `resource`.
+inline std::shared_ptr<buffer_info> make_buffer_info(
+    buffer_info&& init,
+    std::size_t bytes,
+    std::size_t alignment,
+    memory_resource* resource,
+    bool zero = false) {
+  Expects(valid_alignment(alignment));
+  resource_allocator<buffer_info> alloc;
+  auto p = alloc.allocate(1);
+  new (p) buffer_info(std::move(init));
+  p->alignment = alignment;
+  p->resource = resource;
+  p->read_only = false;
+  try {
+    p->ptr = zero ? resource->allocate_zeroed(bytes, alignment)
+                  : resource->allocate(bytes, alignment);
+  } catch (...) {
+    p->~buffer_info();
+    alloc.deallocate(p, 1);
+    throw;
+  }
+  return std::shared_ptr<buffer_info>(p, buffer_info_deleter{bytes}, alloc);
+}
+
+// Describes memory that belongs to `owner`; the payload is not freed when
+// the buffer_info goes away, only the reference to `owner` is dropped.
+inline std::shared_ptr<buffer_info> make_borrowed_info(
+    const layout& l,
+    void* ptr,
+    std::shared_ptr<void> owner,
+    bool read_only = false) {
+  resource_allocator<buffer_info> alloc;
+  auto p = alloc.allocate(1);
+  new (p) buffer_info();
+  static_cast<layout&>(*p) = l;
+  p->ptr = ptr;
+  p->alignment = pointer_alignment(ptr);
+  p->resource = get_default_resource();
+  p->read_only = read_only;
+  return std::shared_ptr<buffer_info>(
+      p, borrowed_info_deleter{std::move(owner)}, alloc);
+}
+
+}  // namespace detail
+
 inline bool operator==(const buffer_info& lhs, const buffer_info& rhs) {
-  return compatible(lhs, rhs) && lhs.ptr == rhs.ptr;
+  return compatible(lhs, rhs) && lhs.strides == rhs.strides &&
+         lhs.ptr == rhs.ptr;
 }
 
 inline bool operator!=(const buffer_info& lhs, const buffer_info& rhs) {
   return !(lhs == rhs);
 }
 
+// Selects the constructors that return zero-filled memory.
+struct zeroed_t {};
+constexpr zeroed_t zeroed{};
+
 class buffer {
  public:
   buffer() = default;
+  buffer(const buffer&) = default;
+  buffer(buffer&&) = default;
+  buffer& operator=(const buffer&) = default;
+  buffer& operator=(buffer&&) = default;
 
   template <class T, class S>
   explicit buffer(S&& s, const T& type_hint = T())
       : buffer(s.begin(), s.end(), type_hint) {}
 
+  template <class T, class S>
+  buffer(
+      S&& s,
+      const T& type_hint,
+      std::size_t alignment,
+      memory_resource* resource = get_default_resource())
+      : buffer(s.begin(), s.end(), type_hint, alignment, resource) {}
+
+  template <class T, class S>
+  buffer(
+      S&& s,
+      const T& type_hint,
+      zeroed_t,
+      std::size_t alignment = default_alignment,
+      memory_resource* resource = get_default_resource())
+      : buffer(s.begin(), s.end(), type_hint, alignment, resource, true) {}
+
   template <class T, class InputIt>
-  buffer(InputIt first, InputIt last, const T& type_hint = T())
-      : info(new buffer_info(), [](buffer_info* p) {
-          free(p->ptr);
-          delete p;
-        }) {
-    info->itemsize = sizeof(T);
-    info->format = FormatDescriptor<T>::format();
-    info->ndim = std::distance(first, last);
-    info->shape = {first, last};
-    info->strides = detail::default_strides<T>(first, last);
-    info->ptr = std::malloc(sizeof(T) * detail::product(first, last));
+  buffer(
+      InputIt first,
+      InputIt last,
+      const T& type_hint = T(),
+      std::size_t alignment = default_alignment,
+      memory_resource* resource = get_default_resource(),
+      bool zero = false) {
+    buffer_info init;
+    init.itemsize = sizeof(T);
+    init.format = FormatDescriptor<T>::code();
+    init.ndim = std::distance(first, last);
+    init.shape.assign(first, last);
+    init.strides = detail::default_strides<T>(first, last);
+    init.rehash();
+    auto bytes = sizeof(T) * detail::product(first, last);
+    alignment = std::max(alignment, alignof(T));
+    info = detail::make_buffer_info(
+        std::move(init), bytes, alignment, resource, zero);
   }
 
  private:
-  void reset(buffer_info* ptr) {
-    info.reset(ptr, [](buffer_info* p) {
-      free(p->ptr);
-      delete p;
-    });
-  }
+  explicit buffer(std::shared_ptr<buffer_info>&& p) : info(std::move(p)) {}
 
  public:
-  friend buffer empty_like(const buffer&);
+  // Wraps memory kept alive by `owner` instead of allocating.
+  buffer(const layout& l, void* ptr, std::shared_ptr<void> owner)
+      : info(detail::make_borrowed_info(l, ptr, std::move(owner))) {}
+
+  // Same, for memory that must not be written through this buffer.
+  buffer(const layout& l, const void* ptr, std::shared_ptr<void> owner)
+      : info(detail::make_borrowed_info(
+            l, const_cast<void*>(ptr), std::move(owner), true)) {}
+
+  friend buffer empty_like(const buffer&, std::size_t, memory_resource*);
+  friend buffer zeros_like(const buffer&, std::size_t, memory_resource*);
+  friend buffer prototype_of(const buffer&);
+
+  // A buffer over (part of) this buffer's memory with a different layout.
+  // The view keeps the whole allocation alive.
+  buffer view(const layout& l, void* ptr) const {
+    return buffer(
+        detail::make_borrowed_info(l, ptr, info, info->read_only));
+  }
 
   virtual ~buffer() {}
 
@@ -118,10 +284,43 @@ class buffer {
 
   std::size_t size_bytes() const { return size() * info->itemsize; }
 
+  std::size_t alignment() const { return info->alignment; }
+
+  long use_count() const { return info.use_count(); }
+
+  bool read_only() const { return info->read_only; }
+
+  // True when nothing else references this buffer's memory, either through
+  // another handle or through a view.
+  bool unique() const {
+    if (info.use_count() != 1) return false;
+    auto d = std::get_deleter<detail::borrowed_info_deleter>(info);
+    return d == nullptr || detail::unique_owner(d->owner);
+  }
+
+  // Copy-on-write: gives this handle a private packed copy unless it
+  // already is the sole owner of writable memory.
+  void make_unique();
+
+  void* mutable_data() {
+    make_unique();
+    return info->ptr;
+  }
+
+  template <class T> T* mutable_data(const T& type_hint = T()) {
+    return static_cast<T*>(mutable_data());
+  }
+
+  bool is_contiguous() const { return info->is_contiguous(); }
+
   template <class T> span<T> as_span() const {
+    Expects(is_contiguous());
     return span<T>(static_cast<T*>(info->ptr), size());
   }
 
+  // Whether this handle refers to a buffer at all.
+  explicit operator bool() const { return bool(info); }
+
   friend bool operator==(const buffer&, const buffer&);
   friend bool operator!=(const buffer&, const buffer&);
 
@@ -142,19 +341,37 @@ inline bool compatible(const buffer& lhs, const buffer& rhs) {
 }
 
 template <class T, class S = std::initializer_list<ssize_t>>
-auto empty(S&& s, const T& type_hint = T()) -> decltype(auto) {
-  return buffer(std::forward<S>(s), type_hint);
+auto empty(
+    S&& s,
+    const T& type_hint = T(),
+    std::size_t alignment = default_alignment,
+    memory_resource* resource = get_default_resource()) -> decltype(auto) {
+  return buffer(std::forward<S>(s), type_hint, alignment, resource);
 }
 
 template <class T, class S = std::initializer_list<ssize_t>>
-auto fill(S&& s, const T& value) -> decltype(auto) {
-  auto ret = buffer(std::forward<S>(s), value);
+auto fill(
+    S&& s,
+    const T& value,
+    std::size_t alignment = default_alignment,
+    memory_resource* resource = get_default_resource()) -> decltype(auto) {
+  auto ret = buffer(std::forward<S>(s), value, alignment, resource);
   auto size = ret.size();
   auto ptr = static_cast<T*>(ret.request().ptr);
   std::fill(ptr, ptr + size, value);
   return ret;
 }
 
+// Zero-filled; large blocks come straight from the OS without being written.
+template <class T, class S = std::initializer_list<ssize_t>>
+auto zeros(
+    S&& s,
+    const T& type_hint = T(),
+    std::size_t alignment = default_alignment,
+    memory_resource* resource = get_default_resource()) -> decltype(auto) {
+  return buffer(std::forward<S>(s), type_hint, zeroed, alignment, resource);
+}
+
 template <class T, class S = std::initializer_list<ssize_t>>
 auto with(std::initializer_list<T>&& ilist, S&& s) -> decltype(auto) {
   auto ret = buffer(std::forward<S>(s), T());
@@ -165,29 +382,72 @@ auto with(std::initializer_list<T>&& ilist, S&& s) -> decltype(auto) {
   return ret;
 }
 
-inline buffer empty_like(const buffer& other) {
-  auto ret(other);
-  auto size = ret.size_bytes();
-  auto& info = ret.request();
-  auto ptr = new buffer_info;
-  ptr->itemsize = info.itemsize;
-  ptr->format = info.format;
-  ptr->ndim = info.ndim;
-  ptr->shape = info.shape;
-  ptr->strides = info.strides;
-  ptr->ptr = std::malloc(size);
-  ret.reset(ptr);
-  return ret;
+namespace detail {
+
+// A packed buffer_info with the layout of `other`. A zero alignment or null
+// resource is taken over from `other`. The contents are not copied, so an
+// event buffer starts out with no events.
+inline std::shared_ptr<buffer_info> make_info_like(
+    const buffer& other,
+    std::size_t alignment,
+    memory_resource* resource,
+    bool zero) {
+  auto& info = other.request();
+  if (alignment == 0) alignment = info.alignment;
+  if (resource == nullptr) resource = info.resource;
+  buffer_info init;
+  static_cast<layout&>(init) = info;
+  init.strides = info.contiguous_strides();
+  init.events.count = 0;
+  auto bytes = other.size_bytes();
+  return make_buffer_info(std::move(init), bytes, alignment, resource, zero);
+}
+
+}  // namespace detail
+
+inline buffer empty_like(
+    const buffer& other,
+    std::size_t alignment = 0,
+    memory_resource* resource = nullptr) {
+  return buffer(detail::make_info_like(other, alignment, resource, false));
 }
 
-inline buffer zeros_like(const buffer& other) {
-  auto ret = empty_like(other);
-  auto size = ret.size_bytes();
-  auto ptr = static_cast<byte*>(ret.request().ptr);
-  std::fill(ptr, ptr + size, byte(0));
+inline buffer copy(const buffer& b) {
+  auto ret = empty_like(b);
+  auto& src = b.request();
+  auto& dst = ret.request();
+  detail::strided_copy(
+      src,
+      static_cast<const char*>(src.ptr),
+      src.strides,
+      static_cast<char*>(dst.ptr),
+      dst.strides,
+      0);
+  dst.events.count = src.events.count;
   return ret;
 }
 
+inline void buffer::make_unique() {
+  if (!unique() || read_only()) *this = copy(*this);
+}
+
+inline buffer zeros_like(
+    const buffer& other,
+    std::size_t alignment = 0,
+    memory_resource* resource = nullptr) {
+  return buffer(detail::make_info_like(other, alignment, resource, true));
+}
+
+// A buffer without memory that describes `other`, down to its alignment
+// and resource, for allocating buffers like it once it is gone.
+inline buffer prototype_of(const buffer& other) {
+  auto& info = other.request();
+  auto p = detail::make_borrowed_info(info, nullptr, nullptr, true);
+  p->alignment = info.alignment;
+  p->resource = info.resource;
+  return buffer(std::move(p));
+}
+
 }  // namespace brica2
 
 #endif  // __BRICA2_BUFFER_HPP__
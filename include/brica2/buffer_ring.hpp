@@ -0,0 +1,113 @@
+#ifndef __BRICA2_BUFFER_RING_HPP__
+#define __BRICA2_BUFFER_RING_HPP__
+
+#include "brica2/assert.hpp"
+#include "brica2/buffer.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace brica2 {
+
+class buffer_ring {
+ public:
+  buffer_ring() : depth(0), next(0), planned(false) {}
+  explicit buffer_ring(std::size_t depth)
+      : depth(depth), next(0), planned(false) {}
+
+  buffer_ring(const buffer_ring&) = default;
+  buffer_ring(buffer_ring&&) = default;
+  buffer_ring& operator=(const buffer_ring&) = default;
+  buffer_ring& operator=(buffer_ring&&) = default;
+
+  std::size_t capacity() const { return depth; }
+  std::size_t size() const { return slots.size(); }
+
+  // A slot is only handed out again once the ring holds the sole reference,
+  // so a buffer still reachable from a port or a downstream component is
+  // never overwritten. Falls back to a fresh allocation when every slot is
+  // in use. Like a fresh allocation, a reused event buffer has no events.
+  buffer acquire(const buffer& like) {
+    if (planned) {
+      auto& slot = slots[next];
+      next = (next + 1) % slots.size();
+      slot.request().events.count = 0;
+      return slot;
+    }
+    for (std::size_t n = 0; n < slots.size(); ++n) {
+      auto& slot = slots[next];
+      next = (next + 1) % slots.size();
+      if (slot.use_count() == 1 && compatible(slot, like)) {
+        slot.request().events.count = 0;
+        return slot;
+      }
+    }
+    if (reusable(spare, like)) {
+      auto ret = std::move(spare);
+      spare = buffer();
+      ret.request().events.count = 0;
+      return ret;
+    }
+    auto ret = empty_like(like);
+    if (slots.size() < depth) slots.push_back(ret);
+    return ret;
+  }
+
+  // Offers a buffer that a port has let go of. It is held in a single
+  // recycle slot, replacing any earlier one, and handed out by acquire()
+  // once nothing else references it. Buffers the ring cycles through
+  // already are not taken twice.
+  void recycle(buffer b) {
+    if (std::find(slots.begin(), slots.end(), b) != slots.end()) return;
+    spare = std::move(b);
+  }
+
+  // Replaces the slots with preplaced buffers, e.g. from a memory plan.
+  // They are handed out in turn without checking for other references:
+  // the plan has already made sure nothing reads a slot when it comes
+  // round again, and slots of different rings may share memory. The first
+  // one counts as handed out already, e.g. as the content of a port.
+  void assign(std::vector<buffer> buffers) {
+    Expects(!buffers.empty());
+    slots = std::move(buffers);
+    depth = std::max(depth, slots.size());
+    next = 1 % slots.size();
+    planned = true;
+  }
+
+  // Whether the slots were assigned rather than grown by acquire().
+  bool assigned() const { return planned; }
+
+  void clear() {
+    slots.clear();
+    spare = buffer();
+    next = 0;
+    planned = false;
+  }
+
+  friend bool operator==(const buffer_ring& lhs, const buffer_ring& rhs) {
+    return lhs.depth == rhs.depth && lhs.slots == rhs.slots;
+  }
+
+  friend bool operator!=(const buffer_ring& lhs, const buffer_ring& rhs) {
+    return !(lhs == rhs);
+  }
+
+ private:
+  // Views, read-only mappings and buffers still referenced elsewhere, e.g.
+  // a constant a functor keeps handing out, are never written to.
+  static bool reusable(const buffer& b, const buffer& like) {
+    return b.unique() && !b.read_only() && b.is_contiguous() &&
+           compatible(b, like);
+  }
+
+  std::size_t depth;
+  std::size_t next;
+  bool planned;
+  std::vector<buffer> slots;
+  buffer spare;
+};
+
+}  // namespace brica2
+
+#endif  // __BRICA2_BUFFER_RING_HPP__
@@ -1,31 +1,101 @@
 #ifndef __BRICA2_COMPONENT_HPP__
 #define __BRICA2_COMPONENT_HPP__
 
+#include "brica2/assert.hpp"
 #include "brica2/buffer.hpp"
+#include "brica2/buffer_ring.hpp"
 #include "brica2/format.hpp"
 #include "brica2/port.hpp"
 #include "brica2/sorted_map.hpp"
 
 #include <functional>
+#include <stdexcept>
+#include <string>
 
 namespace brica2 {
 
 struct component_type {
   virtual bool thread_safe() const { return false; }
+  // A pure component's outputs depend on nothing but its inputs, so the
+  // schedulers skip it in steps where none of them changed.
+  virtual bool pure() const { return false; }
+  // Whether any input has new content since the last collect().
+  virtual bool inputs_changed() const { return true; }
+  // The component's ports, for schedulers that follow its connections.
+  virtual std::vector<port*> input_ports() { return {}; }
+  virtual std::vector<port*> output_ports() { return {}; }
+  // Whether outputs cycle through slots placed by plan_outputs(), which
+  // count on a barrier between a consumer's read and the next write.
+  virtual bool planned() const { return false; }
   virtual void collect() = 0;
   virtual void execute() = 0;
   virtual void expose() = 0;
 };
 
-class dictionary : public sorted_map<std::string, buffer> {};
-using functor_type = std::function<void(const dictionary&, dictionary&)>;
+enum class port_direction { in, out };
+
+// The position of a port among a component's inputs or outputs, resolved
+// once from its key so that functors index instead of searching by string
+// every step. Handles are typed by direction, so an in-handle does not
+// index outputs. They stay valid until more ports are added, which shifts
+// positions; the port count they were resolved at is checked on use.
+template <port_direction D> struct port_handle {
+  std::size_t index;
+  std::size_t stamp;
+};
+
+using in_port_handle = port_handle<port_direction::in>;
+using out_port_handle = port_handle<port_direction::out>;
+
+class dictionary : public sorted_map<std::string, buffer> {
+ public:
+  using sorted_map::operator[];
+};
+
+// The inputs or outputs handed to a functor, indexed by handles of the
+// same direction.
+template <port_direction D> class port_dictionary : public dictionary {
+ public:
+  using dictionary::operator[];
+
+  buffer& operator[](port_handle<D> h) {
+    Expects(h.stamp == size());
+    return index(h.index);
+  }
+
+  const buffer& operator[](port_handle<D> h) const {
+    Expects(h.stamp == size());
+    return index(h.index);
+  }
+};
+
+using input_dictionary = port_dictionary<port_direction::in>;
+using output_dictionary = port_dictionary<port_direction::out>;
+
+namespace detail {
+
+template <port_direction D, class M>
+port_handle<D> resolve(const M& map, const std::string& key) {
+  auto it = map.lower_bound(key);
+  if (it == map.end() || it->first != key) {
+    throw std::out_of_range("no port named " + key);
+  }
+  return port_handle<D>{std::size_t(it - map.begin()), map.size()};
+}
+
+}  // namespace detail
+
+using functor_type =
+    std::function<void(const input_dictionary&, output_dictionary&)>;
 
 class basic_component : public component_type {
  public:
   basic_component() = delete;
 
-  explicit basic_component(const functor_type& f) : functor(f) {}
-  explicit basic_component(functor_type&& f) : functor(f) {}
+  explicit basic_component(const functor_type& f)
+      : functor(f), depth(0), purity(false), collected(false) {}
+  explicit basic_component(functor_type&& f)
+      : functor(f), depth(0), purity(false), collected(false) {}
 
   basic_component(const basic_component&) = default;
   basic_component(basic_component&&) = default;
@@ -36,6 +106,33 @@ class basic_component : public component_type {
 
   virtual bool thread_safe() const override { return true; }
 
+  // Marks the functor as free of state and side effects; see pure().
+  void set_pure(bool p = true) { purity = p; }
+  virtual bool pure() const override { return purity; }
+
+  virtual bool inputs_changed() const override {
+    if (!collected || seen.size() != in_ports.size()) return true;
+    for (std::size_t i = 0; i < in_ports.size(); ++i) {
+      if (in_ports.index(i).generation() != seen[i]) return true;
+    }
+    return false;
+  }
+
+  virtual std::vector<port*> input_ports() override {
+    return addresses(in_ports);
+  }
+
+  virtual std::vector<port*> output_ports() override {
+    return addresses(out_ports);
+  }
+
+  virtual bool planned() const override {
+    for (std::size_t i = 0; i < rings.size(); ++i) {
+      if (rings.index(i).assigned()) return true;
+    }
+    return false;
+  }
+
   template <class T, class S = std::initializer_list<ssize_t>>
   void make_in_port(const std::string& key, S&& s) {
     in_ports.try_emplace(key, std::forward<S>(s), T());
@@ -46,47 +143,141 @@ class basic_component : public component_type {
   void make_out_port(const std::string& key, S&& s) {
     out_ports.try_emplace(key, std::forward<S>(s), T());
     outputs.try_emplace(key, fill(std::forward<S>(s), T()));
+    prototypes.try_emplace(key, prototype_of(outputs.at(key)));
+    rings.try_emplace(key, depth);
   }
 
+  // Ports carrying buffers laid out like `prototype`, such as event
+  // buffers or quantized ones. They start out zeroed, or with no events.
+  void make_in_port(const std::string& key, const buffer& prototype) {
+    in_ports.try_emplace(key, zeros_like(prototype));
+    inputs.try_emplace(key, zeros_like(prototype));
+  }
+
+  void make_out_port(const std::string& key, const buffer& prototype) {
+    out_ports.try_emplace(key, zeros_like(prototype));
+    outputs.try_emplace(key, zeros_like(prototype));
+    prototypes.try_emplace(key, prototype_of(outputs.at(key)));
+    rings.try_emplace(key, depth);
+  }
+
+  // Reuse up to `n` output buffers per port across steps instead of
+  // allocating a fresh one on every execute. Zero disables reuse.
+  void set_buffering(std::size_t n) {
+    depth = n;
+    for (std::size_t i = 0; i < rings.size(); ++i) {
+      rings.index(i) = buffer_ring(depth);
+    }
+  }
+
+  std::size_t get_buffering() const { return depth; }
+
   port& get_in_port(const std::string& key) { return in_ports.at(key); }
   port& get_out_port(const std::string& key) { return out_ports.at(key); }
 
   buffer& get_input(const std::string& key) { return inputs.at(key); }
-  buffer& get_output(const std::string& key) { return outputs.at(key); }
+  // The output of the last execute(), which after expose() is the content
+  // of its port.
+  buffer& get_output(const std::string& key) {
+    auto& output = outputs.at(key);
+    return output ? output : out_ports.at(key).get();
+  }
+
+  // Handles for indexing the dictionaries passed to the functor.
+  in_port_handle in_handle(const std::string& key) const {
+    return detail::resolve<port_direction::in>(in_ports, key);
+  }
+
+  out_port_handle out_handle(const std::string& key) const {
+    return detail::resolve<port_direction::out>(out_ports, key);
+  }
+
+  port& get_in_port(in_port_handle h) {
+    Expects(h.stamp == in_ports.size());
+    return in_ports.index(h.index);
+  }
+
+  port& get_out_port(out_port_handle h) {
+    Expects(h.stamp == out_ports.size());
+    return out_ports.index(h.index);
+  }
+
+  std::size_t out_port_count() const { return out_ports.size(); }
+  port& out_port_at(std::size_t i) { return out_ports.index(i); }
+
+  // Makes the i-th output cycle through `slots`, the first of which becomes
+  // the current output and port content.
+  void place_output(std::size_t i, std::vector<buffer> slots) {
+    for (auto& slot : slots) {
+      if (!compatible(slot, prototypes.index(i))) {
+        throw incompatible_exception();
+      }
+    }
+    outputs.index(i) = slots.front();
+    out_ports.index(i).set(slots.front());
+    rings.index(i).assign(std::move(slots));
+  }
 
   virtual void collect() override {
+    collected = true;
+    seen.resize(in_ports.size());
     for (std::size_t i = 0; i < in_ports.size(); ++i) {
-      if (!compatible(inputs.index(i), in_ports.index(i).get())) {
+      auto& p = in_ports.index(i);
+      seen[i] = p.generation();
+      if (p.merging()) p.merge();
+      if (!compatible(inputs.index(i), p.get())) {
         throw incompatible_exception();
       }
-      inputs.index(i) = in_ports.index(i).get();
+      inputs.index(i) = p.get();
     }
   }
 
   virtual void execute() override {
     for (std::size_t i = 0; i < outputs.size(); ++i) {
-      outputs.index(i) = empty_like(outputs.index(i));
+      outputs.index(i) = rings.index(i).acquire(prototypes.index(i));
     }
     functor(inputs, outputs);
   }
 
   virtual void expose() override {
     for (std::size_t i = 0; i < out_ports.size(); ++i) {
-      if (!compatible(outputs.index(i), out_ports.index(i).get())) {
+      auto& output = outputs.index(i);
+      if (!output) continue;
+      if (!compatible(output, prototypes.index(i))) {
         throw incompatible_exception();
       }
-      out_ports.index(i).get() = outputs.index(i);
+      // Views pass as they are, strided ones too: a consumer that needs
+      // flat data packs it with ascontiguous().
+      // The port keeps the only handle, so the producer holds none that
+      // would make its consumers copy before writing.
+      rings.index(i).recycle(out_ports.index(i).set(std::move(output)));
     }
   }
 
  private:
+  static std::vector<port*> addresses(sorted_map<std::string, port>& ports) {
+    std::vector<port*> ret;
+    for (std::size_t i = 0; i < ports.size(); ++i) {
+      ret.push_back(&ports.index(i));
+    }
+    return ret;
+  }
+
   functor_type functor;
 
   sorted_map<std::string, port> in_ports;
   sorted_map<std::string, port> out_ports;
 
-  dictionary inputs;
-  dictionary outputs;
+  input_dictionary inputs;
+  output_dictionary outputs;
+  dictionary prototypes;
+
+  sorted_map<std::string, buffer_ring> rings;
+  std::size_t depth;
+
+  bool purity;
+  bool collected;
+  std::vector<generation_t> seen;
 };
 
 using component = basic_component;
@@ -96,13 +287,29 @@ struct port_spec {
   std::string k;
 };
 
-inline void connect(port_spec&& source, port_spec&& target) {
-  auto& source_port = source.c.get_out_port(source.k);
-  auto& target_port = target.c.get_in_port(target.k);
-  if (!compatible(source_port.get(), target_port.get())) {
+// Connects ports directly, e.g. those of a static_component. The target
+// is rebound to the source, or takes it as one more source if it merges
+// several (see brica2/fan_in.hpp); with a delay, it becomes a delay line
+// that sees what the source exposed `delay` steps earlier. The source port
+// keeps the handles of its last outputs instead of copying them through a
+// chain of components; give the source at least `delay + 2` buffering
+// slots to keep steady-state steps free of allocations.
+inline void connect(port& source, port& target, std::size_t delay = 0) {
+  if (!compatible(source.get(), target.get())) {
     throw incompatible_exception();
   }
-  target_port = source_port;
+  auto bound = delay == 0 ? source : source.delayed(delay);
+  if (target.merging()) {
+    target.add_source(bound);
+  } else {
+    target = bound;
+  }
+}
+
+inline void connect(
+    port_spec&& source, port_spec&& target, std::size_t delay = 0) {
+  connect(
+      source.c.get_out_port(source.k), target.c.get_in_port(target.k), delay);
 }
 
 }  // namespace brica2
@@ -0,0 +1,305 @@
+#ifndef __BRICA2_CONVERT_HPP__
+#define __BRICA2_CONVERT_HPP__
+
+#include "brica2/assert.hpp"
+#include "brica2/buffer.hpp"
+#include "brica2/half.hpp"
+#include "brica2/kernels.hpp"
+#include "brica2/simd.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace brica2 {
+namespace simd {
+
+struct conversion_kernels {
+  void (*half_to_float)(const float16*, float*, std::size_t);
+  void (*float_to_half)(const float*, float16*, std::size_t);
+  void (*bfloat_to_float)(const bfloat16*, float*, std::size_t);
+  void (*float_to_bfloat)(const float*, bfloat16*, std::size_t);
+};
+
+// The vector kernels below finish with these for the remainder.
+namespace scalar {
+
+inline void half_to_float(const float16* a, float* out, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) out[i] = a[i];
+}
+
+inline void float_to_half(const float* a, float16* out, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) out[i] = a[i];
+}
+
+inline void bfloat_to_float(const bfloat16* a, float* out, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) out[i] = a[i];
+}
+
+inline void float_to_bfloat(const float* a, bfloat16* out, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) out[i] = a[i];
+}
+
+}  // namespace scalar
+}  // namespace simd
+}  // namespace brica2
+
+#if BRICA2_SIMD_X86
+
+// float to bfloat16 without AVX-512 BF16: round to nearest even by adding
+// 0x7fff plus the lowest kept bit, then patch in quieted NaNs and flushed
+// subnormals, matching detail::float_to_bfloat.
+
+BRICA2_SIMD_BEGIN_AVX2
+namespace brica2 {
+namespace simd {
+namespace avx2 {
+
+inline void half_to_float(const float16* a, float* out, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    auto h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(h));
+  }
+  scalar::half_to_float(a + i, out + i, n - i);
+}
+
+inline void float_to_half(const float* a, float16* out, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    auto h = _mm256_cvtps_ph(
+        _mm256_loadu_ps(a + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), h);
+  }
+  scalar::float_to_half(a + i, out + i, n - i);
+}
+
+inline void bfloat_to_float(const bfloat16* a, float* out, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    auto x = _mm256_slli_epi32(_mm256_cvtepu16_epi32(b), 16);
+    _mm256_storeu_ps(out + i, _mm256_castsi256_ps(x));
+  }
+  scalar::bfloat_to_float(a + i, out + i, n - i);
+}
+
+inline void float_to_bfloat(const float* a, bfloat16* out, std::size_t n) {
+  const auto one = _mm256_set1_epi32(1);
+  const auto bias = _mm256_set1_epi32(0x7fff);
+  const auto quiet = _mm256_set1_epi32(0x0040);
+  const auto sign = _mm256_set1_epi32(0x8000);
+  const auto exponent = _mm256_set1_epi32(0x7f800000);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    auto f = _mm256_loadu_ps(a + i);
+    auto x = _mm256_castps_si256(f);
+    auto high = _mm256_srli_epi32(x, 16);
+    auto odd = _mm256_and_si256(high, one);
+    auto r = _mm256_srli_epi32(
+        _mm256_add_epi32(_mm256_add_epi32(x, bias), odd), 16);
+    auto nan = _mm256_castps_si256(_mm256_cmp_ps(f, f, _CMP_UNORD_Q));
+    r = _mm256_blendv_epi8(r, _mm256_or_si256(high, quiet), nan);
+    auto tiny = _mm256_cmpeq_epi32(
+        _mm256_and_si256(x, exponent), _mm256_setzero_si256());
+    r = _mm256_blendv_epi8(r, _mm256_and_si256(high, sign), tiny);
+    // packus works within 128-bit lanes; gather both halves into the low one.
+    auto packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(r, r), 0xd8);
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(out + i), _mm256_castsi256_si128(packed));
+  }
+  scalar::float_to_bfloat(a + i, out + i, n - i);
+}
+
+}  // namespace avx2
+}  // namespace simd
+}  // namespace brica2
+BRICA2_SIMD_END
+
+BRICA2_SIMD_BEGIN_AVX512
+namespace brica2 {
+namespace simd {
+namespace avx512 {
+
+// The zero-masked forms with a full mask avoid the undefined source
+// register of the plain intrinsics, as in simd.hpp.
+constexpr __mmask16 all = 0xffff;
+
+inline void half_to_float(const float16* a, float* out, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    _mm512_storeu_ps(out + i, _mm512_maskz_cvtph_ps(all, h));
+  }
+  avx2::half_to_float(a + i, out + i, n - i);
+}
+
+inline void float_to_half(const float* a, float16* out, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto h = _mm512_maskz_cvtps_ph(
+        all,
+        _mm512_loadu_ps(a + i),
+        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), h);
+  }
+  avx2::float_to_half(a + i, out + i, n - i);
+}
+
+inline void bfloat_to_float(const bfloat16* a, float* out, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    auto x = _mm512_maskz_slli_epi32(
+        all, _mm512_maskz_cvtepu16_epi32(all, b), 16);
+    _mm512_storeu_ps(out + i, _mm512_castsi512_ps(x));
+  }
+  avx2::bfloat_to_float(a + i, out + i, n - i);
+}
+
+inline void float_to_bfloat(const float* a, bfloat16* out, std::size_t n) {
+  const auto one = _mm512_set1_epi32(1);
+  const auto bias = _mm512_set1_epi32(0x7fff);
+  const auto quiet = _mm512_set1_epi32(0x0040);
+  const auto sign = _mm512_set1_epi32(0x8000);
+  const auto exponent = _mm512_set1_epi32(0x7f800000);
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto f = _mm512_loadu_ps(a + i);
+    auto x = _mm512_castps_si512(f);
+    auto high = _mm512_maskz_srli_epi32(all, x, 16);
+    auto odd = _mm512_and_si512(high, one);
+    auto r = _mm512_maskz_srli_epi32(
+        all, _mm512_add_epi32(_mm512_add_epi32(x, bias), odd), 16);
+    auto nan = _mm512_cmp_ps_mask(f, f, _CMP_UNORD_Q);
+    r = _mm512_mask_or_epi32(r, nan, high, quiet);
+    auto normal = _mm512_test_epi32_mask(x, exponent);
+    r = _mm512_mask_and_epi32(r, ~normal, high, sign);
+    auto packed = _mm512_maskz_cvtepi32_epi16(all, r);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+  }
+  avx2::float_to_bfloat(a + i, out + i, n - i);
+}
+
+}  // namespace avx512
+}  // namespace simd
+}  // namespace brica2
+BRICA2_SIMD_END
+
+BRICA2_SIMD_BEGIN("avx512bf16,avx512f,avx2,fma,f16c")
+namespace brica2 {
+namespace simd {
+namespace avx512_bf16 {
+
+inline void float_to_bfloat(const float* a, bfloat16* out, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto b = _mm512_cvtneps_pbh(_mm512_loadu_ps(a + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), (__m256i)b);
+  }
+  avx2::float_to_bfloat(a + i, out + i, n - i);
+}
+
+}  // namespace avx512_bf16
+}  // namespace simd
+}  // namespace brica2
+BRICA2_SIMD_END
+
+#endif  // BRICA2_SIMD_X86
+
+namespace brica2 {
+namespace simd {
+
+inline bool has_avx512_bf16() {
+#if BRICA2_SIMD_X86
+  static const bool value = detected_isa() == isa::avx512 &&
+                            __builtin_cpu_supports("avx512bf16");
+  return value;
+#else
+  return false;
+#endif
+}
+
+inline conversion_kernels make_conversion_kernels(isa target) {
+#if BRICA2_SIMD_X86
+  switch (target) {
+    case isa::avx512:
+      return {
+          &avx512::half_to_float,
+          &avx512::float_to_half,
+          &avx512::bfloat_to_float,
+          has_avx512_bf16() ? &avx512_bf16::float_to_bfloat
+                            : &avx512::float_to_bfloat};
+    case isa::avx2:
+      return {
+          &avx2::half_to_float,
+          &avx2::float_to_half,
+          &avx2::bfloat_to_float,
+          &avx2::float_to_bfloat};
+    default: break;
+  }
+#endif  // BRICA2_SIMD_X86
+  return {
+      &scalar::half_to_float,
+      &scalar::float_to_half,
+      &scalar::bfloat_to_float,
+      &scalar::float_to_bfloat};
+}
+
+// The conversion kernels for the active instruction set. Below AVX2 (which
+// brings F16C) conversions are scalar.
+inline const conversion_kernels& conversions() {
+  static const conversion_kernels tables[] = {
+      make_conversion_kernels(isa::scalar),
+      make_conversion_kernels(isa::sse2),
+      make_conversion_kernels(isa::avx2),
+      make_conversion_kernels(isa::avx512)};
+  return tables[static_cast<int>(active_isa())];
+}
+
+}  // namespace simd
+
+// Converts a float buffer to float16 or bfloat16 or back. Other pairs of
+// dtypes are not supported, except that matching dtypes are copied. Shapes
+// must match; `out` is made writable first as in the elementwise kernels.
+inline void convert(const buffer& a, buffer& out) {
+  if (a.request().shape != out.request().shape) {
+    throw incompatible_exception();
+  }
+  out.make_unique();
+  Expects(out.is_contiguous());
+  auto x = detail::packed(a);
+  auto from = x.request().format.value;
+  auto to = out.request().format.value;
+  auto n = out.size();
+  auto& k = simd::conversions();
+  if (from == to) {
+    std::memcpy(out.data(), x.data(), out.size_bytes());
+  } else if (from == 'e' && to == 'f') {
+    k.half_to_float(
+        detail::cdata<float16>(x), detail::mdata<float>(out), n);
+  } else if (from == 'f' && to == 'e') {
+    k.float_to_half(
+        detail::cdata<float>(x), detail::mdata<float16>(out), n);
+  } else if (from == 'E' && to == 'f') {
+    k.bfloat_to_float(
+        detail::cdata<bfloat16>(x), detail::mdata<float>(out), n);
+  } else if (from == 'f' && to == 'E') {
+    k.float_to_bfloat(
+        detail::cdata<float>(x), detail::mdata<bfloat16>(out), n);
+  } else {
+    Expects(false);
+  }
+}
+
+// A new buffer with the contents of `a` converted to T, e.g. astype<float>
+// to compute on float16 storage and astype<float16> to store the result.
+template <class T> buffer astype(const buffer& a) {
+  auto out = empty<T>(a.request().shape);
+  convert(a, out);
+  return out;
+}
+
+}  // namespace brica2
+
+#endif  // __BRICA2_CONVERT_HPP__
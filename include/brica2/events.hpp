@@ -0,0 +1,209 @@
+#ifndef __BRICA2_EVENTS_HPP__
+#define __BRICA2_EVENTS_HPP__
+
+#include "brica2/assert.hpp"
+#include "brica2/buffer.hpp"
+#include "brica2/format.hpp"
+#include "brica2/kernels.hpp"
+#include "brica2/span.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace brica2 {
+
+// Event buffers hold the addresses of the active sources of a population,
+// e.g. the neurons that spiked this step, instead of one element per
+// source. They are ordinary buffers of event_address with the extent of
+// the population in their layout, so ports, connect() and buffer rings
+// treat them like any other content; a dense port does not accept them.
+// With a payload the buffer has a second row of 32-bit values, one per
+// event. Only the first event_count() entries of each row are meaningful.
+using event_address = std::uint32_t;
+
+namespace detail {
+
+inline std::size_t event_rows(const layout& l) {
+  return l.events.payload.value == '\0' ? 1 : 2;
+}
+
+inline std::size_t event_capacity(const layout& l) {
+  return l.shape[l.ndim - 1];
+}
+
+inline buffer make_events(ssize_t extent, ssize_t capacity, char payload) {
+  Expects(extent > 0);
+  Expects(std::uint64_t(extent) <= std::numeric_limits<event_address>::max());
+  Expects(capacity >= 0);
+  if (capacity == 0) capacity = extent;
+  auto ret = payload == '\0' ? empty<event_address>({capacity})
+                             : empty<event_address>({2, capacity});
+  auto& info = ret.request();
+  info.events.extent = extent;
+  info.events.payload = payload;
+  info.rehash();
+  return ret;
+}
+
+}  // namespace detail
+
+// An event buffer with no events for `extent` sources, with room for
+// `capacity` events (by default, all of them).
+inline buffer make_events(ssize_t extent, ssize_t capacity = 0) {
+  return detail::make_events(extent, capacity, '\0');
+}
+
+// As above, with a payload of type T (a 32-bit type such as float) for
+// every event.
+template <class T> buffer make_events(ssize_t extent, ssize_t capacity = 0) {
+  static_assert(
+      sizeof(T) == sizeof(event_address) && std::is_trivially_copyable<T>(),
+      "event payloads are 32-bit values");
+  return detail::make_events(extent, capacity, FormatDescriptor<T>::code());
+}
+
+inline std::size_t event_count(const buffer& b) {
+  return b.request().events.count;
+}
+
+inline span<const event_address> event_addresses(const buffer& b) {
+  auto& info = b.request();
+  Expects(info.events.sparse());
+  return span<const event_address>(
+      static_cast<const event_address*>(info.ptr), info.events.count);
+}
+
+template <class T> span<const T> event_payload(const buffer& b) {
+  auto& info = b.request();
+  Expects(info.events.payload == FormatDescriptor<T>::code());
+  auto rows = static_cast<const event_address*>(info.ptr);
+  return span<const T>(
+      reinterpret_cast<const T*>(rows + detail::event_capacity(info)),
+      info.events.count);
+}
+
+inline void clear_events(buffer& b) {
+  Expects(b.request().events.sparse());
+  b.request().events.count = 0;
+}
+
+inline void add_event(buffer& b, event_address address) {
+  auto& info = b.request();
+  Expects(info.events.payload == '\0');
+  Expects(address < std::size_t(info.events.extent));
+  Expects(info.events.count < detail::event_capacity(info));
+  static_cast<event_address*>(info.ptr)[info.events.count++] = address;
+}
+
+template <class T> void add_event(buffer& b, event_address address, T value) {
+  auto& info = b.request();
+  Expects(info.events.payload == FormatDescriptor<T>::code());
+  Expects(address < std::size_t(info.events.extent));
+  auto capacity = detail::event_capacity(info);
+  Expects(info.events.count < capacity);
+  auto rows = static_cast<event_address*>(info.ptr);
+  rows[info.events.count] = address;
+  std::memcpy(rows + capacity + info.events.count, &value, sizeof(value));
+  ++info.events.count;
+}
+
+// The events of the nonzero elements of `dense`, taken in row-major order
+// as addresses. Fails if there are more than `capacity` of them.
+inline buffer to_events(const buffer& dense, ssize_t capacity = 0) {
+  Expects(!dense.request().events.sparse());
+  auto x = detail::packed(dense);
+  auto ret = make_events(ssize_t(x.size()), capacity);
+  auto& info = ret.request();
+  auto out = static_cast<event_address*>(info.ptr);
+  auto limit = detail::event_capacity(info);
+  std::size_t count = 0;
+  detail::visit_numeric(x.request().format, [&](auto t) {
+    using T = decltype(t);
+    auto p = detail::cdata<T>(x);
+    for (std::size_t i = 0, n = x.size(); i < n; ++i) {
+      if (p[i] == T(0)) continue;
+      Expects(count < limit);
+      out[count++] = event_address(i);
+    }
+  });
+  info.events.count = count;
+  return ret;
+}
+
+// As above, with the values of the elements as payload; `dense` holds T.
+template <class T>
+buffer to_events(const buffer& dense, ssize_t capacity = 0) {
+  Expects(dense.request().format == FormatDescriptor<T>::code());
+  Expects(!dense.request().events.sparse());
+  auto x = detail::packed(dense);
+  auto ret = make_events<T>(ssize_t(x.size()), capacity);
+  auto p = detail::cdata<T>(x);
+  for (std::size_t i = 0, n = x.size(); i < n; ++i) {
+    if (p[i] != T(0)) add_event(ret, event_address(i), p[i]);
+  }
+  return ret;
+}
+
+// A dense buffer of T for the whole population: the payload of each event
+// at its address (or one without a payload) and zero elsewhere.
+template <class T = float> buffer to_dense(const buffer& events) {
+  auto& info = events.request();
+  Expects(info.events.sparse());
+  auto ret = zeros<T>({info.events.extent});
+  auto out = detail::mdata<T>(ret);
+  auto addresses = event_addresses(events);
+  if (info.events.payload == '\0') {
+    for (auto a : addresses) out[a] = T(1);
+  } else {
+    auto values = event_payload<T>(events);
+    for (std::size_t i = 0; i < event_count(events); ++i) {
+      out[addresses[i]] = values[i];
+    }
+  }
+  return ret;
+}
+
+namespace detail {
+
+// The wire format of an event buffer: the count, then the addresses and
+// the payloads of the active events only. `words` must have room for
+// max_event_words(). Returns the number of words written.
+inline std::size_t max_event_words(const layout& l) {
+  return 1 + event_rows(l) * event_capacity(l);
+}
+
+inline std::size_t pack_events(const buffer& b, event_address* words) {
+  auto& info = b.request();
+  auto count = info.events.count;
+  auto rows = static_cast<const event_address*>(info.ptr);
+  words[0] = event_address(count);
+  std::memcpy(words + 1, rows, count * sizeof(event_address));
+  if (event_rows(info) == 1) return 1 + count;
+  std::memcpy(
+      words + 1 + count,
+      rows + event_capacity(info),
+      count * sizeof(event_address));
+  return 1 + 2 * count;
+}
+
+inline void unpack_events(const event_address* words, buffer& b) {
+  auto& info = b.request();
+  std::size_t count = words[0];
+  auto capacity = event_capacity(info);
+  Expects(count <= capacity);
+  auto rows = static_cast<event_address*>(info.ptr);
+  std::memcpy(rows, words + 1, count * sizeof(event_address));
+  if (event_rows(info) == 2) {
+    std::memcpy(
+        rows + capacity, words + 1 + count, count * sizeof(event_address));
+  }
+  info.events.count = count;
+}
+
+}  // namespace detail
+}  // namespace brica2
+
+#endif  // __BRICA2_EVENTS_HPP__
@@ -8,6 +8,13 @@ namespace brica2 {
 class executor_type {
  public:
   virtual void post(std::function<void()> f) = 0;
+
+  // Tasks posted with the same key run on the same worker, for executors
+  // that keep such an assignment. Others ignore the key.
+  virtual void post(const void* /* key */, std::function<void()> f) {
+    post(std::move(f));
+  }
+
   virtual void sync() = 0;
 };
 
@@ -0,0 +1,144 @@
+#ifndef __BRICA2_EXECUTOR_NUMA_HPP__
+#define __BRICA2_EXECUTOR_NUMA_HPP__
+
+#include "brica2/executor.hpp"
+#include "brica2/executor/parallel.hpp"
+#include "brica2/numa.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace brica2 {
+
+// Like parallel, but every worker has its own queue and is bound to one NUMA
+// node, workers being spread over the nodes in turn. A keyed task always
+// goes to the worker its key was first given to, so a component keeps
+// executing (and allocating) on the same node step after step. On a single
+// node machine this is a parallel executor with sticky assignment.
+class numa_parallel : public executor_type {
+ public:
+  numa_parallel(thread_count_t n = 0) : next(0), pending(0) {
+    auto& topology = numa_topology::get();
+    auto size = default_concurrency(n);
+    for (std::size_t i = 0; i < size; ++i) {
+      workers.emplace_back(new worker_t(i % topology.size()));
+    }
+    for (auto& w : workers) {
+      auto p = w.get();
+      w->thread = std::thread([this, p] { run(*p); });
+      bind_to_node(w->thread, w->node);
+    }
+  }
+
+  virtual ~numa_parallel() {
+    for (auto& w : workers) {
+      {
+        std::lock_guard<std::mutex> lock{w->mutex};
+        w->stop = true;
+      }
+      w->condition.notify_one();
+    }
+    for (auto& w : workers) w->thread.join();
+  }
+
+  virtual void post(std::function<void()> f) override {
+    std::size_t index;
+    {
+      std::lock_guard<std::mutex> lock{assignment_mutex};
+      index = next++ % workers.size();
+    }
+    push(*workers[index], std::move(f));
+  }
+
+  virtual void post(const void* key, std::function<void()> f) override {
+    std::size_t index;
+    {
+      std::lock_guard<std::mutex> lock{assignment_mutex};
+      auto it = assignment.find(key);
+      if (it == assignment.end()) {
+        it = assignment.emplace(key, next++ % workers.size()).first;
+      }
+      index = it->second;
+    }
+    push(*workers[index], std::move(f));
+  }
+
+  virtual void sync() override {
+    std::unique_lock<std::mutex> lock{mutex};
+    condition.wait(lock, [this] { return pending == 0; });
+  }
+
+  std::size_t size() const { return workers.size(); }
+
+  // The worker `key` is assigned to, or size() if it has not been posted.
+  std::size_t worker_of(const void* key) const {
+    std::lock_guard<std::mutex> lock{assignment_mutex};
+    auto it = assignment.find(key);
+    return it == assignment.end() ? workers.size() : it->second;
+  }
+
+  std::size_t node_of_worker(std::size_t i) const { return workers[i]->node; }
+
+ private:
+  struct worker_t {
+    explicit worker_t(std::size_t node) : node(node), stop(false) {}
+
+    std::size_t node;
+    std::thread thread;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stop;
+  };
+
+  void push(worker_t& w, std::function<void()>&& f) {
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      ++pending;
+    }
+    {
+      std::lock_guard<std::mutex> lock{w.mutex};
+      w.tasks.push_back(std::move(f));
+    }
+    w.condition.notify_one();
+  }
+
+  void run(worker_t& w) {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock{w.mutex};
+        w.condition.wait(lock, [&w] { return !w.tasks.empty() || w.stop; });
+        if (w.stop && w.tasks.empty()) return;
+        task = std::move(w.tasks.front());
+        w.tasks.pop_front();
+      }
+      task();
+      {
+        std::lock_guard<std::mutex> lock{mutex};
+        --pending;
+      }
+      condition.notify_all();
+    }
+  }
+
+  std::vector<std::unique_ptr<worker_t>> workers;
+  std::size_t next;
+
+  mutable std::mutex assignment_mutex;
+  std::unordered_map<const void*, std::size_t> assignment;
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::size_t pending;
+};
+
+}  // namespace brica2
+
+#endif  // __BRICA2_EXECUTOR_NUMA_HPP__
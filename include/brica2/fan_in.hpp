@@ -0,0 +1,187 @@
+#ifndef __BRICA2_FAN_IN_HPP__
+#define __BRICA2_FAN_IN_HPP__
+
+#include "brica2/assert.hpp"
+#include "brica2/buffer.hpp"
+#include "brica2/buffer_ring.hpp"
+#include "brica2/events.hpp"
+#include "brica2/executor.hpp"
+#include "brica2/kernels.hpp"
+#include "brica2/port.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace brica2 {
+
+// How a fan-in port combines its sources, elementwise. logical_or gives
+// one where any source is nonzero; for event buffers it is the union of
+// their events.
+enum class fan_in_op { sum, max, logical_or };
+
+namespace detail {
+
+template <class T>
+void logical_or(const T* a, const T* b, T* out, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) {
+    out[i] = T((a[i] != T(0)) | (b[i] != T(0)));
+  }
+}
+
+template <class T>
+void (*fan_in_kernel(fan_in_op op))(const T*, const T*, T*, std::size_t) {
+  switch (op) {
+    case fan_in_op::sum: return simd::elementwise<T>().add;
+    case fan_in_op::max: return simd::elementwise<T>().max;
+    default: return &logical_or<T>;
+  }
+}
+
+}  // namespace detail
+
+// The merge behind a fan-in port. Each step it reduces the current
+// contents of its sources into a buffer from its own ring. Sources are
+// folded one after another; with an executor and at least
+// `parallel_threshold` sources, the elements are split into slices, about
+// one per hardware thread, and each slice is folded by a task of its own.
+// The executor must not be the one running the component itself, since
+// the reduction waits on it.
+class fan_in : public port_merge {
+ public:
+  explicit fan_in(
+      fan_in_op op,
+      executor_type* executor = nullptr,
+      std::size_t parallel_threshold = 8)
+      : op(op),
+        executor(executor),
+        parallel_threshold(std::max<std::size_t>(parallel_threshold, 2)),
+        ring(2) {}
+
+  virtual void add_source(const port& source) override {
+    inputs.push_back(source);
+  }
+
+  virtual std::size_t source_count() const override { return inputs.size(); }
+  virtual std::vector<port> sources() const override { return inputs; }
+
+  // Generations only grow, so their sum does whenever any of them does.
+  virtual generation_t generation() const override {
+    generation_t ret = 0;
+    for (auto& source : inputs) ret += source.generation();
+    return ret;
+  }
+
+  virtual buffer merge(const buffer& like) override {
+    auto out = ring.acquire(like);
+    if (like.request().events.sparse()) {
+      merge_events(out);
+      return out;
+    }
+    operands.clear();
+    for (auto& source : inputs) {
+      operands.push_back(detail::packed(source.get()));
+    }
+    detail::visit_numeric(out.request().format, [&](auto t) {
+      using T = decltype(t);
+      reduce<T>(out);
+    });
+    return out;
+  }
+
+ private:
+  template <class T> void reduce(buffer& out) {
+    auto kernel = detail::fan_in_kernel<T>(op);
+    auto dst = detail::mdata<T>(out);
+    auto n = out.size();
+    if (operands.size() == 1) {
+      std::copy_n(detail::cdata<T>(operands[0]), n, dst);
+    } else if (executor == nullptr || operands.size() < parallel_threshold) {
+      fold<T>(kernel, dst, 0, n);
+    } else {
+      reduce_slices<T>(kernel, dst, n);
+    }
+  }
+
+  // Folds every operand into dst[lo, hi).
+  template <class T, class K>
+  void fold(K kernel, T* dst, std::size_t lo, std::size_t hi) {
+    auto n = hi - lo;
+    kernel(
+        detail::cdata<T>(operands[0]) + lo,
+        detail::cdata<T>(operands[1]) + lo, dst + lo, n);
+    for (std::size_t i = 2; i < operands.size(); ++i) {
+      kernel(dst + lo, detail::cdata<T>(operands[i]) + lo, dst + lo, n);
+    }
+  }
+
+  // Tasks own disjoint slices of `dst`, so they need no scratch and the
+  // reduction a single sync. Slices are whole vectors of at least
+  // `min_slice` elements, to keep tasks from getting too small to pay off.
+  template <class T, class K>
+  void reduce_slices(K kernel, T* dst, std::size_t n) {
+    static const std::size_t min_slice = 4096;
+    std::size_t tasks = std::max(1u, std::thread::hardware_concurrency());
+    auto slice = std::max((n + tasks - 1) / tasks, min_slice);
+    slice = (slice + 15) / 16 * 16;
+    for (std::size_t lo = 0; lo < n; lo += slice) {
+      auto hi = std::min(n, lo + slice);
+      executor->post([=]() { fold<T>(kernel, dst, lo, hi); });
+    }
+    executor->sync();
+  }
+
+  // Events are merged as a union of addresses. With payloads, the first
+  // source to report an address wins.
+  void merge_events(buffer& out) {
+    Expects(op == fan_in_op::logical_or);
+    auto& info = out.request();
+    auto rows = static_cast<event_address*>(info.ptr);
+    auto capacity = detail::event_capacity(info);
+    auto payloads = detail::event_rows(info) == 2;
+    std::size_t count = 0;
+    mask.assign(info.events.extent, false);
+    for (auto& source : inputs) {
+      auto& from = source.get().request();
+      auto addresses = static_cast<const event_address*>(from.ptr);
+      for (std::size_t i = 0; i < from.events.count; ++i) {
+        auto a = addresses[i];
+        if (mask[a]) continue;
+        mask[a] = true;
+        Expects(count < capacity);
+        rows[count] = a;
+        if (payloads) {
+          rows[capacity + count] = addresses[detail::event_capacity(from) + i];
+        }
+        ++count;
+      }
+    }
+    info.events.count = count;
+  }
+
+  fan_in_op op;
+  executor_type* executor;
+  std::size_t parallel_threshold;
+  buffer_ring ring;
+  std::vector<port> inputs;
+  std::vector<buffer> operands;
+  std::vector<bool> mask;
+};
+
+// Turns `p` into a fan-in port: every port connected to it afterwards adds
+// a source, and each step it reads their combination under `op`. Event
+// ports only merge under logical_or.
+inline void make_fan_in(
+    port& p,
+    fan_in_op op,
+    executor_type* executor = nullptr,
+    std::size_t parallel_threshold = 8) {
+  Expects(op == fan_in_op::logical_or || !p.get().request().events.sparse());
+  p.set_merge(std::make_shared<fan_in>(op, executor, parallel_threshold));
+}
+
+}  // namespace brica2
+
+#endif  // __BRICA2_FAN_IN_HPP__
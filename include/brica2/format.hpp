@@ -1,6 +1,7 @@
 #ifndef __BRICA2_FORMAT_HPP__
 #define __BRICA2_FORMAT_HPP__
 
+#include "brica2/half.hpp"
 #include "brica2/type_traits.hpp"
 
 #include <string>
@@ -18,16 +19,20 @@ template <class T, class... Ts> struct format_t {
 }  // namespace detail
 
 template <class T> struct FormatDescriptor {
-  static auto format() -> decltype(auto) {
+  static constexpr char code() {
     // clang-format off
     using format_t = detail::format_t<
       T, char, signed char, unsigned char, bool, short, unsigned short, int,
       unsigned int, long, unsigned long, long long, unsigned long long, ssize_t,
-      std::size_t, float, double
+      std::size_t, float, double, float16, bfloat16
     >;
     // clang-format on
-    return std::string(format_t("cbB?hHiIlLqQnNfd").value);
+    // 'e' is the struct module's half precision code; bfloat16 has none,
+    // so it takes the upper case of it.
+    return format_t("cbB?hHiIlLqQnNfdeE").value[0];
   }
+
+  static auto format() -> decltype(auto) { return std::string(1, code()); }
 };
 
 }  // namespace brica2
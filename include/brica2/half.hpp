@@ -0,0 +1,104 @@
+#ifndef __BRICA2_HALF_HPP__
+#define __BRICA2_HALF_HPP__
+
+#include <cstdint>
+#include <cstring>
+
+namespace brica2 {
+namespace detail {
+
+inline std::uint32_t float_bits(float f) {
+  std::uint32_t u;
+  std::memcpy(&u, &f, sizeof(u));
+  return u;
+}
+
+inline float bits_float(std::uint32_t u) {
+  float f;
+  std::memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+// IEEE 754 binary16, rounding to nearest even. NaNs stay NaNs with the
+// quiet bit set and the top of the payload kept, as F16C does.
+inline std::uint16_t float_to_half(float f) {
+  auto x = float_bits(f);
+  std::uint16_t sign = (x >> 16) & 0x8000;
+  x &= 0x7fffffff;
+  if (x > 0x7f800000) return sign | 0x7e00 | ((x >> 13) & 0x3ff);
+  // 65520 and above round to infinity.
+  if (x >= 0x477ff000) return sign | 0x7c00;
+  if (x < 0x38800000) {
+    // Subnormal or zero: adding 0.5 puts the 10 mantissa bits at the
+    // bottom of a float and lets the FPU do the rounding.
+    return sign | (float_bits(bits_float(x) + 0.5f) - 0x3f000000);
+  }
+  auto odd = (x >> 13) & 1;
+  x += 0xc8000fff + odd;  // rebias the exponent and round
+  return sign | (x >> 13);
+}
+
+inline float half_to_float(std::uint16_t h) {
+  std::uint32_t sign = std::uint32_t(h & 0x8000) << 16;
+  std::uint32_t exponent = (h >> 10) & 0x1f;
+  std::uint32_t mantissa = h & 0x3ff;
+  if (exponent == 0) {
+    auto magnitude = bits_float(0x33800000) * float(mantissa);  // 2^-24 m
+    return bits_float(sign | float_bits(magnitude));
+  }
+  if (exponent == 0x1f) {
+    return bits_float(
+        sign | 0x7f800000 | (mantissa << 13) | (mantissa ? 0x400000 : 0));
+  }
+  return bits_float(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+// The top half of a float, rounding to nearest even. Like the AVX-512 BF16
+// instructions, subnormals are flushed to zero and NaNs are quieted.
+inline std::uint16_t float_to_bfloat(float f) {
+  auto x = float_bits(f);
+  if ((x & 0x7fffffff) > 0x7f800000) return (x >> 16) | 0x0040;
+  if ((x & 0x7f800000) == 0) return (x >> 16) & 0x8000;
+  return (x + 0x7fff + ((x >> 16) & 1)) >> 16;
+}
+
+inline float bfloat_to_float(std::uint16_t b) {
+  return bits_float(std::uint32_t(b) << 16);
+}
+
+}  // namespace detail
+
+// 16-bit floating point storage types. They convert to and from float;
+// arithmetic happens in float.
+
+struct float16 {
+  float16() = default;
+  float16(float f) : bits(detail::float_to_half(f)) {}
+  operator float() const { return detail::half_to_float(bits); }
+
+  static float16 from_bits(std::uint16_t b) {
+    float16 ret;
+    ret.bits = b;
+    return ret;
+  }
+
+  std::uint16_t bits;
+};
+
+struct bfloat16 {
+  bfloat16() = default;
+  bfloat16(float f) : bits(detail::float_to_bfloat(f)) {}
+  operator float() const { return detail::bfloat_to_float(bits); }
+
+  static bfloat16 from_bits(std::uint16_t b) {
+    bfloat16 ret;
+    ret.bits = b;
+    return ret;
+  }
+
+  std::uint16_t bits;
+};
+
+}  // namespace brica2
+
+#endif  // __BRICA2_HALF_HPP__
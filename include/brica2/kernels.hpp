@@ -0,0 +1,279 @@
+#ifndef __BRICA2_KERNELS_HPP__
+#define __BRICA2_KERNELS_HPP__
+
+#include "brica2/assert.hpp"
+#include "brica2/buffer.hpp"
+#include "brica2/simd.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace brica2 {
+namespace simd {
+
+template <class T> struct elementwise_kernels {
+  using unary_type = void (*)(const T*, T*, std::size_t);
+  using binary_type = void (*)(const T*, const T*, T*, std::size_t);
+  using ternary_type =
+      void (*)(const T*, const T*, const T*, T*, std::size_t);
+  using clamp_type = void (*)(const T*, T*, std::size_t, T, T);
+
+  binary_type add;
+  binary_type mul;
+  binary_type max;
+  ternary_type fma;
+  clamp_type clamp;
+  unary_type relu;
+  unary_type sigmoid;
+};
+
+}  // namespace simd
+}  // namespace brica2
+
+#define BRICA2_SIMD_ISA scalar
+#include "brica2/simd/elementwise.hpp"
+#undef BRICA2_SIMD_ISA
+
+#if BRICA2_SIMD_X86
+BRICA2_SIMD_BEGIN_SSE2
+#define BRICA2_SIMD_ISA sse2
+#include "brica2/simd/elementwise.hpp"
+#undef BRICA2_SIMD_ISA
+BRICA2_SIMD_END
+
+BRICA2_SIMD_BEGIN_AVX2
+#define BRICA2_SIMD_ISA avx2
+#include "brica2/simd/elementwise.hpp"
+#undef BRICA2_SIMD_ISA
+BRICA2_SIMD_END
+
+BRICA2_SIMD_BEGIN_AVX512
+#define BRICA2_SIMD_ISA avx512
+#include "brica2/simd/elementwise.hpp"
+#undef BRICA2_SIMD_ISA
+BRICA2_SIMD_END
+#endif  // BRICA2_SIMD_X86
+
+namespace brica2 {
+namespace simd {
+
+// Floating point types, and the integer ones with lane-wise add, multiply
+// and compare on every instruction set. 8-bit integers have no multiply
+// and 64-bit ones no multiply or compare before AVX-512, so they, like
+// unsigned integers, stay scalar.
+template <class T>
+struct has_vector
+    : std::integral_constant<bool, std::is_floating_point<T>::value ||
+                                       std::is_same<T, std::int32_t>::value ||
+                                       std::is_same<T, std::int16_t>::value> {
+};
+
+template <class T>
+elementwise_kernels<T> make_elementwise_kernels(isa, std::false_type) {
+  return scalar::make_elementwise_kernels<T>();
+}
+
+template <class T>
+elementwise_kernels<T> make_elementwise_kernels(isa target, std::true_type) {
+#if BRICA2_SIMD_X86
+  switch (target) {
+    case isa::avx512: return avx512::make_elementwise_kernels<T>();
+    case isa::avx2: return avx2::make_elementwise_kernels<T>();
+    case isa::sse2: return sse2::make_elementwise_kernels<T>();
+    default: break;
+  }
+#endif  // BRICA2_SIMD_X86
+  return scalar::make_elementwise_kernels<T>();
+}
+
+// The kernels for T on the active instruction set.
+template <class T> const elementwise_kernels<T>& elementwise() {
+  static const elementwise_kernels<T> tables[] = {
+      make_elementwise_kernels<T>(isa::scalar, has_vector<T>()),
+      make_elementwise_kernels<T>(isa::sse2, has_vector<T>()),
+      make_elementwise_kernels<T>(isa::avx2, has_vector<T>()),
+      make_elementwise_kernels<T>(isa::avx512, has_vector<T>())};
+  return tables[static_cast<int>(active_isa())];
+}
+
+}  // namespace simd
+
+namespace detail {
+
+// Calls f(T()) with T the element type named by a dtype code. Only numeric
+// types are accepted.
+template <class F> decltype(auto) visit_numeric(format_code code, F&& f) {
+  switch (code.value) {
+    case 'b': return f((signed char)0);
+    case 'B': return f((unsigned char)0);
+    case 'h': return f(short());
+    case 'H': return f((unsigned short)0);
+    case 'i': return f(int());
+    case 'I': return f(0u);
+    case 'l': return f(0l);
+    case 'L': return f(0ul);
+    case 'q': return f(0ll);
+    case 'Q': return f(0ull);
+    case 'f': return f(float());
+    case 'd': return f(double());
+  }
+  Expects(false);
+  return f(float());
+}
+
+// `out` must match every operand. It is made writable first (copying it if
+// it is shared, see buffer::make_unique), so that passing an operand as
+// `out` works in place whenever that operand is not referenced elsewhere.
+template <class... Buffers>
+void prepare_output(buffer& out, const Buffers&... operands) {
+  for (auto* operand : {&operands...}) {
+    if (!compatible(*operand, out)) throw incompatible_exception();
+  }
+  out.make_unique();
+  Expects(out.is_contiguous());
+}
+
+inline buffer packed(const buffer& b) {
+  return b.is_contiguous() ? b : copy(b);
+}
+
+template <class T> const T* cdata(const buffer& b) {
+  return static_cast<const T*>(b.data());
+}
+
+template <class T> T* mdata(buffer& b) { return static_cast<T*>(b.data()); }
+
+}  // namespace detail
+
+// Elementwise arithmetic over whole buffers. Operands must be compatible
+// (same dtype and shape) and may be strided; the work is done by the kernels
+// for the active instruction set (see simd::active_isa()). The forms taking
+// `out` write into it, and may be given one of the operands as `out`.
+
+inline void add(const buffer& a, const buffer& b, buffer& out) {
+  detail::prepare_output(out, a, b);
+  auto x = detail::packed(a), y = detail::packed(b);
+  detail::visit_numeric(x.request().format, [&](auto t) {
+    using T = decltype(t);
+    simd::elementwise<T>().add(
+        detail::cdata<T>(x), detail::cdata<T>(y), detail::mdata<T>(out),
+        out.size());
+  });
+}
+
+inline void mul(const buffer& a, const buffer& b, buffer& out) {
+  detail::prepare_output(out, a, b);
+  auto x = detail::packed(a), y = detail::packed(b);
+  detail::visit_numeric(x.request().format, [&](auto t) {
+    using T = decltype(t);
+    simd::elementwise<T>().mul(
+        detail::cdata<T>(x), detail::cdata<T>(y), detail::mdata<T>(out),
+        out.size());
+  });
+}
+
+// Elementwise maximum. As with the x86 instructions, a NaN in `a` gives
+// the element of `b`.
+inline void maximum(const buffer& a, const buffer& b, buffer& out) {
+  detail::prepare_output(out, a, b);
+  auto x = detail::packed(a), y = detail::packed(b);
+  detail::visit_numeric(x.request().format, [&](auto t) {
+    using T = decltype(t);
+    simd::elementwise<T>().max(
+        detail::cdata<T>(x), detail::cdata<T>(y), detail::mdata<T>(out),
+        out.size());
+  });
+}
+
+// a * b + c
+inline void fma(
+    const buffer& a, const buffer& b, const buffer& c, buffer& out) {
+  detail::prepare_output(out, a, b, c);
+  auto x = detail::packed(a), y = detail::packed(b), z = detail::packed(c);
+  detail::visit_numeric(x.request().format, [&](auto t) {
+    using T = decltype(t);
+    simd::elementwise<T>().fma(
+        detail::cdata<T>(x), detail::cdata<T>(y), detail::cdata<T>(z),
+        detail::mdata<T>(out), out.size());
+  });
+}
+
+inline void clamp(const buffer& a, double lo, double hi, buffer& out) {
+  Expects(lo <= hi);
+  detail::prepare_output(out, a);
+  auto x = detail::packed(a);
+  detail::visit_numeric(x.request().format, [&](auto t) {
+    using T = decltype(t);
+    simd::elementwise<T>().clamp(
+        detail::cdata<T>(x), detail::mdata<T>(out), out.size(), T(lo), T(hi));
+  });
+}
+
+inline void relu(const buffer& a, buffer& out) {
+  detail::prepare_output(out, a);
+  auto x = detail::packed(a);
+  detail::visit_numeric(x.request().format, [&](auto t) {
+    using T = decltype(t);
+    simd::elementwise<T>().relu(
+        detail::cdata<T>(x), detail::mdata<T>(out), out.size());
+  });
+}
+
+// Floating point buffers only.
+inline void sigmoid(const buffer& a, buffer& out) {
+  detail::prepare_output(out, a);
+  auto x = detail::packed(a);
+  detail::visit_numeric(x.request().format, [&](auto t) {
+    using T = decltype(t);
+    auto kernel = simd::elementwise<T>().sigmoid;
+    Expects(kernel != nullptr);
+    kernel(detail::cdata<T>(x), detail::mdata<T>(out), out.size());
+  });
+}
+
+inline buffer add(const buffer& a, const buffer& b) {
+  auto out = empty_like(a);
+  add(a, b, out);
+  return out;
+}
+
+inline buffer mul(const buffer& a, const buffer& b) {
+  auto out = empty_like(a);
+  mul(a, b, out);
+  return out;
+}
+
+inline buffer maximum(const buffer& a, const buffer& b) {
+  auto out = empty_like(a);
+  maximum(a, b, out);
+  return out;
+}
+
+inline buffer fma(const buffer& a, const buffer& b, const buffer& c) {
+  auto out = empty_like(a);
+  fma(a, b, c, out);
+  return out;
+}
+
+inline buffer clamp(const buffer& a, double lo, double hi) {
+  auto out = empty_like(a);
+  clamp(a, lo, hi, out);
+  return out;
+}
+
+inline buffer relu(const buffer& a) {
+  auto out = empty_like(a);
+  relu(a, out);
+  return out;
+}
+
+inline buffer sigmoid(const buffer& a) {
+  auto out = empty_like(a);
+  sigmoid(a, out);
+  return out;
+}
+
+}  // namespace brica2
+
+#endif  // __BRICA2_KERNELS_HPP__
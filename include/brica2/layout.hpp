@@ -0,0 +1,240 @@
+#ifndef __BRICA2_LAYOUT_HPP__
+#define __BRICA2_LAYOUT_HPP__
+
+#include "brica2/assert.hpp"
+#include "brica2/typedef.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <string>
+#include <type_traits>
+
+#ifndef BRICA2_MAX_RANK
+#define BRICA2_MAX_RANK 8
+#endif  // BRICA2_MAX_RANK
+
+namespace brica2 {
+
+constexpr std::size_t max_rank = BRICA2_MAX_RANK;
+
+template <class T, std::size_t N> class inline_vector {
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using iterator = T*;
+  using const_iterator = const T*;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  inline_vector() : count(0), values{} {}
+
+  inline_vector(size_type n, const T& value) : inline_vector() {
+    Expects(n <= N);
+    std::fill(values, values + n, value);
+    count = n;
+  }
+
+  template <
+      class InputIt,
+      class = typename std::iterator_traits<InputIt>::iterator_category>
+  inline_vector(InputIt first, InputIt last) : inline_vector() {
+    assign(first, last);
+  }
+
+  inline_vector(std::initializer_list<T> ilist)
+      : inline_vector(ilist.begin(), ilist.end()) {}
+
+  template <class InputIt> void assign(InputIt first, InputIt last) {
+    size_type n = 0;
+    for (; first != last; ++first, ++n) {
+      Expects(n < N);
+      values[n] = *first;
+    }
+    if (n < count) std::fill(values + n, values + count, T());
+    count = n;
+  }
+
+  iterator begin() { return values; }
+  const_iterator begin() const { return values; }
+  iterator end() { return values + count; }
+  const_iterator end() const { return values + count; }
+
+  reverse_iterator rbegin() { return reverse_iterator(end()); }
+  const_reverse_iterator rbegin() const { return reverse_iterator(end()); }
+  reverse_iterator rend() { return reverse_iterator(begin()); }
+  const_reverse_iterator rend() const { return reverse_iterator(begin()); }
+
+  T& operator[](size_type i) { return values[i]; }
+  const T& operator[](size_type i) const { return values[i]; }
+
+  T* data() { return values; }
+  const T* data() const { return values; }
+
+  size_type size() const { return count; }
+  bool empty() const { return count == 0; }
+  static constexpr size_type capacity() { return N; }
+
+  friend bool operator==(const inline_vector& lhs, const inline_vector& rhs) {
+    return lhs.count == rhs.count &&
+           std::equal(lhs.begin(), lhs.end(), rhs.begin());
+  }
+
+  friend bool operator!=(const inline_vector& lhs, const inline_vector& rhs) {
+    return !(lhs == rhs);
+  }
+
+ private:
+  size_type count;
+  T values[N];
+};
+
+using extents = inline_vector<ssize_t, max_rank>;
+
+struct format_code {
+  char value;
+
+  format_code() = default;
+  constexpr format_code(char c) : value(c) {}
+  format_code(const std::string& s) : value(s.empty() ? '\0' : s[0]) {}
+
+  std::string str() const { return std::string(1, value); }
+  operator std::string() const { return str(); }
+
+  friend bool operator==(format_code lhs, format_code rhs) {
+    return lhs.value == rhs.value;
+  }
+  friend bool operator!=(format_code lhs, format_code rhs) {
+    return !(lhs == rhs);
+  }
+
+  friend bool operator==(format_code lhs, const std::string& rhs) {
+    return rhs.size() == 1 && lhs.value == rhs[0];
+  }
+  friend bool operator==(const std::string& lhs, format_code rhs) {
+    return rhs == lhs;
+  }
+  friend bool operator!=(format_code lhs, const std::string& rhs) {
+    return !(lhs == rhs);
+  }
+  friend bool operator!=(const std::string& lhs, format_code rhs) {
+    return !(lhs == rhs);
+  }
+
+  friend bool operator==(format_code lhs, const char* rhs) {
+    return rhs[0] == lhs.value && rhs[0] != '\0' && rhs[1] == '\0';
+  }
+  friend bool operator!=(format_code lhs, const char* rhs) {
+    return !(lhs == rhs);
+  }
+};
+
+// Affine quantization of integer elements: an element q stands for the
+// real value scale * (q - zero_point). A zero scale means the elements are
+// plain values.
+struct quantization {
+  float scale = 0;
+  std::int32_t zero_point = 0;
+
+  bool quantized() const { return scale != 0; }
+};
+
+inline bool operator==(const quantization& lhs, const quantization& rhs) {
+  return lhs.scale == rhs.scale && lhs.zero_point == rhs.zero_point;
+}
+
+inline bool operator!=(const quantization& lhs, const quantization& rhs) {
+  return !(lhs == rhs);
+}
+
+// Address-event representation (see brica2/events.hpp): the buffer lists
+// the addresses of the active sources among `extent` of them, followed by a
+// row of 32-bit payload values of format `payload` if there is one. A zero
+// extent marks an ordinary dense buffer.
+struct event_space {
+  ssize_t extent = 0;
+  std::size_t count = 0;
+  format_code payload = '\0';
+
+  bool sparse() const { return extent != 0; }
+};
+
+// Everything about a buffer except where it lives. Fixed-size and trivially
+// copyable; `hash` must be refreshed with rehash() after editing fields.
+// Strides describe how the elements are laid out in memory, not what they
+// are, so they take no part in the hash or in compatible(). Neither does
+// `quant`: a producer may requantize every step, and the parameters travel
+// with each buffer it hands out. Of `events`, the extent and payload format
+// count, the number of active events does not.
+struct layout {
+  ssize_t itemsize;
+  format_code format;
+  ssize_t ndim;
+  extents shape;
+  extents strides;
+  quantization quant;
+  event_space events;
+  std::uint64_t hash;
+
+  void rehash() {
+    std::uint64_t h = 14695981039346656037ull;
+    auto mix = [&h](std::uint64_t v) {
+      for (int i = 0; i < 8; ++i, v >>= 8) {
+        h ^= v & 0xff;
+        h *= 1099511628211ull;
+      }
+    };
+    mix(static_cast<std::uint64_t>(itemsize));
+    mix(static_cast<unsigned char>(format.value));
+    mix(static_cast<std::uint64_t>(ndim));
+    for (auto v : shape) mix(static_cast<std::uint64_t>(v));
+    if (events.sparse()) {
+      mix(static_cast<std::uint64_t>(events.extent));
+      mix(static_cast<unsigned char>(events.payload.value));
+    }
+    hash = h;
+  }
+
+  // Row-major strides for the current shape and itemsize.
+  extents contiguous_strides() const {
+    extents ret(shape.size(), itemsize);
+    for (std::size_t i = shape.size(); i > 1; --i) {
+      ret[i - 2] = ret[i - 1] * shape[i - 1];
+    }
+    return ret;
+  }
+
+  bool is_contiguous() const {
+    for (std::size_t i = 0; i < shape.size(); ++i) {
+      if (shape[i] == 0) return true;
+    }
+    ssize_t expected = itemsize;
+    for (std::size_t i = shape.size(); i > 0; --i) {
+      if (shape[i - 1] != 1 && strides[i - 1] != expected) return false;
+      expected *= shape[i - 1];
+    }
+    return true;
+  }
+};
+
+static_assert(
+    std::is_trivially_copyable<layout>::value,
+    "layout must stay trivially copyable");
+
+// Layouts are compared by hash alone. Debug builds check that equal hashes
+// do mean equal fields.
+inline bool compatible(const layout& lhs, const layout& rhs) {
+  if (lhs.hash != rhs.hash) return false;
+#ifndef NDEBUG
+  Expects(lhs.itemsize == rhs.itemsize && lhs.format == rhs.format &&
+          lhs.ndim == rhs.ndim && lhs.shape == rhs.shape &&
+          lhs.events.extent == rhs.events.extent &&
+          lhs.events.payload == rhs.events.payload);
+#endif
+  return true;
+}
+
+}  // namespace brica2
+
+#endif  // __BRICA2_LAYOUT_HPP__
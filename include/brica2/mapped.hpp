@@ -0,0 +1,177 @@
+#ifndef __BRICA2_MAPPED_HPP__
+#define __BRICA2_MAPPED_HPP__
+
+#include "brica2/assert.hpp"
+#include "brica2/buffer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace brica2 {
+
+// read_only maps the file shared, so every process mapping it reads the same
+// page cache pages. copy_on_write maps it private: writes stay local to the
+// process and never reach the file.
+enum class map_mode { read_only, copy_on_write };
+
+class mapped_format_exception : public std::exception {
+ public:
+  const char* what() const noexcept override {
+    return "file is not a mapped buffer";
+  }
+};
+
+namespace detail {
+
+// On-disk header, in native byte order. The payload starts at `offset`,
+// which is page aligned, and is stored packed in row-major order. Files
+// written before the quantization fields existed have zeros there.
+struct mapped_header {
+  static constexpr std::size_t max_rank = 8;
+
+  char magic[8];
+  std::uint32_t version;
+  char format;
+  char reserved[3];
+  std::uint64_t itemsize;
+  std::uint64_t ndim;
+  std::uint64_t offset;
+  std::uint64_t shape[max_rank];
+  float scale;
+  std::int32_t zero_point;
+};
+
+constexpr char mapped_magic[8] = {'B', 'R', 'I', 'C', 'A', '2', 'M', 'B'};
+constexpr std::uint32_t mapped_version = 1;
+constexpr std::size_t mapped_page = 4096;
+
+struct file_descriptor {
+  explicit file_descriptor(int fd) : fd(fd) {}
+  ~file_descriptor() {
+    if (fd >= 0) ::close(fd);
+  }
+  int fd;
+};
+
+[[noreturn]] inline void throw_errno(const std::string& what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+inline bool write_all(int fd, const void* data, std::size_t bytes) {
+  auto p = static_cast<const char*>(data);
+  while (bytes > 0) {
+    auto n = ::write(fd, p, bytes);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    bytes -= n;
+  }
+  return true;
+}
+
+}  // namespace detail
+
+// Writes `b` in the format read by map_file().
+inline void save_mapped(const buffer& b, const std::string& path) {
+  auto packed = b.is_contiguous() ? b : copy(b);
+  auto& info = packed.request();
+  Expects(std::size_t(info.ndim) <= detail::mapped_header::max_rank);
+  Expects(!info.events.sparse());
+
+  detail::mapped_header header{};
+  std::memcpy(header.magic, detail::mapped_magic, sizeof(header.magic));
+  header.version = detail::mapped_version;
+  header.format = info.format.value;
+  header.itemsize = info.itemsize;
+  header.ndim = info.ndim;
+  header.offset = detail::mapped_page;
+  std::copy(info.shape.begin(), info.shape.end(), header.shape);
+  header.scale = info.quant.scale;
+  header.zero_point = info.quant.zero_point;
+
+  detail::file_descriptor file(
+      ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+  if (file.fd < 0) detail::throw_errno(path);
+  char page[detail::mapped_page] = {};
+  std::memcpy(page, &header, sizeof(header));
+  if (!detail::write_all(file.fd, page, sizeof(page)) ||
+      !detail::write_all(file.fd, info.ptr, packed.size_bytes())) {
+    detail::throw_errno(path);
+  }
+}
+
+// Maps a file written by save_mapped(). Nothing but the header is read up
+// front; payload pages are faulted in on first access. The mapping stays
+// alive as long as the buffer or any view of it.
+inline buffer map_file(
+    const std::string& path, map_mode mode = map_mode::read_only) {
+  detail::file_descriptor file(::open(path.c_str(), O_RDONLY));
+  if (file.fd < 0) detail::throw_errno(path);
+
+  struct stat st;
+  if (::fstat(file.fd, &st) != 0) detail::throw_errno(path);
+  std::size_t file_size = st.st_size;
+
+  detail::mapped_header header;
+  if (file_size < sizeof(header) ||
+      ::pread(file.fd, &header, sizeof(header), 0) != ssize_t(sizeof(header))) {
+    throw mapped_format_exception();
+  }
+  if (std::memcmp(header.magic, detail::mapped_magic, sizeof(header.magic)) !=
+          0 ||
+      header.version != detail::mapped_version || header.ndim > max_rank ||
+      header.ndim > detail::mapped_header::max_rank || header.itemsize == 0 ||
+      header.offset % detail::mapped_page != 0) {
+    throw mapped_format_exception();
+  }
+
+  layout l;
+  l.itemsize = header.itemsize;
+  l.format = header.format;
+  l.ndim = header.ndim;
+  l.shape.assign(header.shape, header.shape + header.ndim);
+  l.strides = l.contiguous_strides();
+  l.quant.scale = header.scale;
+  l.quant.zero_point = header.zero_point;
+  l.rehash();
+
+  std::size_t bytes =
+      l.itemsize * detail::product(l.shape.begin(), l.shape.end());
+  if (header.offset > file_size || bytes > file_size - header.offset) {
+    throw mapped_format_exception();
+  }
+
+  // mmap rejects zero-length mappings; keep the header page mapped so that
+  // empty buffers still get a valid pointer.
+  std::size_t length = header.offset + bytes;
+  int prot = PROT_READ;
+  int flags = MAP_SHARED;
+  if (mode == map_mode::copy_on_write) {
+    prot |= PROT_WRITE;
+    flags = MAP_PRIVATE;
+  }
+  void* addr = ::mmap(nullptr, length, prot, flags, file.fd, 0);
+  if (addr == MAP_FAILED) detail::throw_errno(path);
+
+  std::shared_ptr<void> owner(
+      addr, [length](void* p) { ::munmap(p, length); });
+  char* payload = static_cast<char*>(addr) + header.offset;
+  if (mode == map_mode::read_only) {
+    return buffer(l, static_cast<const void*>(payload), std::move(owner));
+  }
+  return buffer(l, static_cast<void*>(payload), std::move(owner));
+}
+
+}  // namespace brica2
+
+#endif  // __BRICA2_MAPPED_HPP__
@@ -0,0 +1,204 @@
+#ifndef __BRICA2_MDSPAN_HPP__
+#define __BRICA2_MDSPAN_HPP__
+
+#include "brica2/assert.hpp"
+#include "brica2/buffer.hpp"
+#include "brica2/format.hpp"
+#include "brica2/span.hpp"
+
+#include <array>
+#include <type_traits>
+
+namespace brica2 {
+
+template <class T, std::ptrdiff_t... Extents> class mdspan;
+
+namespace detail {
+
+template <class T, std::size_t N, std::ptrdiff_t... Es> struct dynamic_mdspan {
+  using type = typename dynamic_mdspan<T, N - 1, dynamic_extent, Es...>::type;
+};
+
+template <class T, std::ptrdiff_t... Es> struct dynamic_mdspan<T, 0, Es...> {
+  using type = mdspan<T, Es...>;
+};
+
+template <std::size_t Axis, class Kept, std::ptrdiff_t... Es>
+struct mdspan_drop;
+
+template <
+    std::size_t Axis,
+    class T,
+    std::ptrdiff_t... Ks,
+    std::ptrdiff_t E0,
+    std::ptrdiff_t... Es>
+struct mdspan_drop<Axis, mdspan<T, Ks...>, E0, Es...> {
+  using type =
+      typename mdspan_drop<Axis - 1, mdspan<T, Ks..., E0>, Es...>::type;
+};
+
+template <
+    class T,
+    std::ptrdiff_t... Ks,
+    std::ptrdiff_t E0,
+    std::ptrdiff_t... Es>
+struct mdspan_drop<0, mdspan<T, Ks...>, E0, Es...> {
+  using type = mdspan<T, Ks..., Es...>;
+};
+
+}  // namespace detail
+
+// Rank-N strided view over T. Each extent is either fixed at compile time
+// or dynamic_extent. Strides are counted in elements.
+template <class T, std::size_t Rank>
+using dynamic_mdspan = typename detail::dynamic_mdspan<T, Rank>::type;
+
+template <class T, std::ptrdiff_t... Extents> class mdspan {
+ public:
+  using element_type = T;
+  using value_type = std::remove_cv_t<T>;
+  using index_type = std::ptrdiff_t;
+  using pointer = T*;
+  using reference = T&;
+  using extents_type = std::array<index_type, sizeof...(Extents)>;
+
+  static constexpr std::size_t rank() { return sizeof...(Extents); }
+
+  static constexpr index_type static_extent(std::size_t r) {
+    const index_type values[] = {Extents..., 0};
+    return values[r];
+  }
+
+  constexpr mdspan() : ptr(nullptr), extents_{}, strides_{} {}
+
+  mdspan(pointer p, const extents_type& e, const extents_type& s)
+      : ptr(p), extents_(e), strides_(s) {
+    for (std::size_t r = 0; r < rank(); ++r) {
+      Expects(
+          static_extent(r) == dynamic_extent || static_extent(r) == e[r]);
+    }
+  }
+
+  // Row-major strides.
+  mdspan(pointer p, const extents_type& e) : mdspan(p, e, packed(e)) {}
+
+  index_type extent(std::size_t r) const {
+    return static_extent(r) == dynamic_extent ? extents_[r] : static_extent(r);
+  }
+
+  index_type stride(std::size_t r) const { return strides_[r]; }
+
+  index_type size() const {
+    index_type ret = 1;
+    for (std::size_t r = 0; r < rank(); ++r) ret *= extent(r);
+    return ret;
+  }
+
+  pointer data() const { return ptr; }
+
+  bool is_contiguous() const { return strides_ == packed(extents_); }
+
+  // Whether the last axis can be walked with unit stride.
+  bool is_unit_stride() const {
+    return rank() == 0 || strides_[rank() - 1] == 1;
+  }
+
+  template <class... Indices> reference operator()(Indices... indices) const {
+    static_assert(sizeof...(Indices) == rank(), "wrong number of indices");
+    index_type offset = 0;
+    std::size_t r = 0;
+    using expand = int[];
+    (void)expand{0, (offset += index_type(indices) * strides_[r++], 0)...};
+    return ptr[offset];
+  }
+
+  // The sub-view at index i of `Axis`, with that axis removed.
+  template <std::size_t Axis>
+  typename detail::mdspan_drop<Axis, mdspan<T>, Extents...>::type select(
+      index_type i) const {
+    using result =
+        typename detail::mdspan_drop<Axis, mdspan<T>, Extents...>::type;
+    Expects(0 <= i && i < extent(Axis));
+    typename result::extents_type e, s;
+    for (std::size_t k = 0, n = 0; k < rank(); ++k) {
+      if (k == Axis) continue;
+      e[n] = extent(k);
+      s[n] = strides_[k];
+      ++n;
+    }
+    return result(ptr + i * strides_[Axis], e, s);
+  }
+
+  template <std::size_t Axis = 0> auto row(index_type i) const {
+    return select<Axis>(i);
+  }
+
+  template <std::size_t Axis = 1> auto column(index_type j) const {
+    return select<Axis>(j);
+  }
+
+  // Elements [first, last) of axis r.
+  dynamic_mdspan<T, sizeof...(Extents)> slice(
+      std::size_t r, index_type first, index_type last) const {
+    Expects(r < rank() && 0 <= first && first <= last && last <= extent(r));
+    extents_type e = extents_;
+    for (std::size_t k = 0; k < rank(); ++k) e[k] = extent(k);
+    e[r] = last - first;
+    return {ptr + first * strides_[r], e, strides_};
+  }
+
+  // The whole view as one unit-stride span; requires is_contiguous().
+  span<T> flat() const {
+    Expects(is_contiguous());
+    return span<T>(ptr, size());
+  }
+
+ private:
+  static extents_type packed(const extents_type& e) {
+    extents_type s{};
+    index_type stride = 1;
+    for (std::size_t r = rank(); r > 0; --r) {
+      s[r - 1] = stride;
+      stride *= e[r - 1];
+    }
+    return s;
+  }
+
+  pointer ptr;
+  extents_type extents_;
+  extents_type strides_;
+};
+
+namespace detail {
+
+template <class Result> Result as_mdspan(const buffer& b) {
+  using T = typename Result::element_type;
+  auto& info = b.request();
+  Expects(info.format == FormatDescriptor<std::remove_cv_t<T>>::code());
+  Expects(std::size_t(info.ndim) == Result::rank());
+  typename Result::extents_type e, s;
+  for (std::size_t r = 0; r < Result::rank(); ++r) {
+    Expects(info.strides[r] % ssize_t(sizeof(T)) == 0);
+    e[r] = info.shape[r];
+    s[r] = info.strides[r] / ssize_t(sizeof(T));
+  }
+  return Result(static_cast<T*>(info.ptr), e, s);
+}
+
+}  // namespace detail
+
+// Typed view over a buffer. The element type must match the buffer's format
+// and the rank and any static extents its shape.
+template <class T, std::ptrdiff_t... Extents>
+mdspan<T, Extents...> as_mdspan(const buffer& b) {
+  return detail::as_mdspan<mdspan<T, Extents...>>(b);
+}
+
+template <class T, std::size_t Rank>
+dynamic_mdspan<T, Rank> as_dynamic_mdspan(const buffer& b) {
+  return detail::as_mdspan<dynamic_mdspan<T, Rank>>(b);
+}
+
+}  // namespace brica2
+
+#endif  // __BRICA2_MDSPAN_HPP__
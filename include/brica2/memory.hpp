@@ -0,0 +1,535 @@
+#ifndef __BRICA2_MEMORY_HPP__
+#define __BRICA2_MEMORY_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace brica2 {
+
+struct memory_resource {
+  virtual ~memory_resource() {}
+  virtual void* allocate(std::size_t bytes, std::size_t alignment) = 0;
+  virtual void deallocate(
+      void* p, std::size_t bytes, std::size_t alignment) = 0;
+
+  // Like allocate(), but the block reads as zeros. Resources that can get
+  // zeroed memory from the OS override this to skip the memset.
+  virtual void* allocate_zeroed(std::size_t bytes, std::size_t alignment) {
+    void* p = allocate(bytes, alignment);
+    std::memset(p, 0, bytes);
+    return p;
+  }
+};
+
+// Large over-aligned blocks are carved out of a bigger malloc()/calloc()
+// block, with the original pointer stored just below the aligned one. That
+// lets zeroed requests use calloc(), which hands out fresh pages from the
+// OS without writing them.
+class malloc_resource : public memory_resource {
+ public:
+  static constexpr std::size_t large = std::size_t(1) << 17;
+
+  virtual void* allocate(std::size_t bytes, std::size_t alignment) override {
+    return allocate_block(bytes, alignment, false);
+  }
+
+  virtual void* allocate_zeroed(
+      std::size_t bytes, std::size_t alignment) override {
+    return allocate_block(bytes, alignment, true);
+  }
+
+  virtual void deallocate(
+      void* p, std::size_t bytes, std::size_t alignment) override {
+    if (carved(bytes, alignment)) p = static_cast<void**>(p)[-1];
+    std::free(p);
+  }
+
+ private:
+  static bool carved(std::size_t bytes, std::size_t alignment) {
+    return bytes >= large && alignment > alignof(std::max_align_t);
+  }
+
+  static void* allocate_block(
+      std::size_t bytes, std::size_t alignment, bool zero) {
+    if (bytes == 0) bytes = 1;
+    void* p = nullptr;
+    if (carved(bytes, alignment)) {
+      auto total = bytes + alignment + sizeof(void*);
+      void* raw = zero ? std::calloc(1, total) : std::malloc(total);
+      if (raw == nullptr) throw std::bad_alloc();
+      auto address = reinterpret_cast<std::uintptr_t>(raw) + sizeof(void*);
+      address = (address + alignment - 1) & ~(alignment - 1);
+      p = reinterpret_cast<void*>(address);
+      static_cast<void**>(p)[-1] = raw;
+      return p;
+    }
+    if (alignment <= alignof(std::max_align_t)) {
+      p = zero ? std::calloc(1, bytes) : std::malloc(bytes);
+    } else if (posix_memalign(&p, alignment, bytes) != 0) {
+      p = nullptr;
+    } else if (zero) {
+      std::memset(p, 0, bytes);
+    }
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+  }
+};
+
+inline memory_resource* new_delete_resource() {
+  static auto* resource = new malloc_resource();
+  return resource;
+}
+
+struct pool_statistics {
+  std::size_t block_size;
+  std::size_t hits;
+  std::size_t misses;
+  std::size_t bytes_live;
+};
+
+namespace detail {
+
+struct pool_state {
+  struct size_class {
+    std::mutex mutex;
+    std::vector<void*> blocks;
+    std::atomic<std::size_t> hits{0};
+    std::atomic<std::size_t> misses{0};
+    std::atomic<std::size_t> bytes_live{0};
+  };
+
+  pool_state(
+      std::size_t min_block,
+      std::size_t max_block,
+      std::size_t alignment,
+      memory_resource* upstream)
+      : min_block(min_block),
+        alignment(alignment),
+        classes(count_classes(min_block, max_block)),
+        upstream(upstream) {}
+
+  ~pool_state() { release(); }
+
+  static std::size_t count_classes(std::size_t min, std::size_t max) {
+    std::size_t n = 1;
+    while (min < max) {
+      min <<= 1;
+      ++n;
+    }
+    return n;
+  }
+
+  std::size_t block_size(std::size_t index) const { return min_block << index; }
+
+  std::size_t index_of(std::size_t bytes) const {
+    std::size_t index = 0;
+    while (block_size(index) < bytes) ++index;
+    return index;
+  }
+
+  void release() {
+    for (std::size_t i = 0; i < classes.size(); ++i) {
+      std::lock_guard<std::mutex> lock{classes[i].mutex};
+      for (auto p : classes[i].blocks) {
+        upstream->deallocate(p, block_size(i), alignment);
+      }
+      classes[i].blocks.clear();
+    }
+  }
+
+  std::size_t min_block;
+  std::size_t alignment;
+  std::vector<size_class> classes;
+  memory_resource* upstream;
+};
+
+// Per-thread free lists in front of the shared ones. Each thread keeps a
+// small stack of blocks per size class and only touches the shared lists in
+// batches; the cached blocks are handed back when the thread exits.
+class pool_thread_cache {
+ public:
+  enum : std::size_t { limit = 32, batch = limit / 2 };
+
+  using lists = std::vector<std::vector<void*>>;
+
+  ~pool_thread_cache() {
+    for (auto& entry : entries) {
+      for (std::size_t i = 0; i < entry.second.size(); ++i) {
+        flush(*entry.first, i, entry.second[i], entry.second[i].size());
+      }
+    }
+  }
+
+  static pool_thread_cache& local() {
+    static thread_local pool_thread_cache cache;
+    return cache;
+  }
+
+  lists& get(const std::shared_ptr<pool_state>& state) {
+    if (last < entries.size() && entries[last].first == state) {
+      return entries[last].second;
+    }
+    for (last = 0; last < entries.size(); ++last) {
+      if (entries[last].first == state) return entries[last].second;
+    }
+    entries.emplace_back(state, lists(state->classes.size()));
+    return entries.back().second;
+  }
+
+  static void flush(
+      pool_state& state,
+      std::size_t index,
+      std::vector<void*>& list,
+      std::size_t n) {
+    if (n == 0) return;
+    auto& c = state.classes[index];
+    std::lock_guard<std::mutex> lock{c.mutex};
+    c.blocks.insert(c.blocks.end(), list.end() - n, list.end());
+    list.resize(list.size() - n);
+  }
+
+  static void refill(
+      pool_state& state, std::size_t index, std::vector<void*>& list) {
+    auto& c = state.classes[index];
+    std::lock_guard<std::mutex> lock{c.mutex};
+    std::size_t n = std::min<std::size_t>(batch, c.blocks.size());
+    list.insert(list.end(), c.blocks.end() - n, c.blocks.end());
+    c.blocks.resize(c.blocks.size() - n);
+  }
+
+ private:
+  std::vector<std::pair<std::shared_ptr<pool_state>, lists>> entries;
+  std::size_t last = 0;
+};
+
+}  // namespace detail
+
+// Size-class pool: requests are rounded up to a power of two between
+// min_block and max_block and recycled through thread-local and shared free
+// lists. Larger or more strictly aligned requests go straight to upstream.
+// The upstream resource must outlive every thread that used the pool.
+class pool_resource : public memory_resource {
+ public:
+  explicit pool_resource(
+      std::size_t max_block = std::size_t(1) << 22,
+      std::size_t min_block = 64,
+      std::size_t alignment = 64,
+      memory_resource* upstream = new_delete_resource())
+      : state(std::make_shared<detail::pool_state>(
+            min_block, max_block, alignment, upstream)) {}
+
+  pool_resource(const pool_resource&) = delete;
+  pool_resource& operator=(const pool_resource&) = delete;
+
+  virtual ~pool_resource() {}
+
+  virtual void* allocate(std::size_t bytes, std::size_t alignment) override {
+    if (oversize(bytes, alignment)) {
+      void* p = state->upstream->allocate(bytes, alignment);
+      ++large_misses;
+      large_bytes_live += bytes;
+      return p;
+    }
+
+    auto index = state->index_of(bytes);
+    auto& c = state->classes[index];
+    auto& list = detail::pool_thread_cache::local().get(state)[index];
+    if (list.empty()) detail::pool_thread_cache::refill(*state, index, list);
+
+    void* p;
+    if (!list.empty()) {
+      p = list.back();
+      list.pop_back();
+      ++c.hits;
+    } else {
+      p = state->upstream->allocate(state->block_size(index), state->alignment);
+      ++c.misses;
+    }
+    c.bytes_live += state->block_size(index);
+    return p;
+  }
+
+  // Pooled blocks are recycled and have to be cleared; large ones come
+  // zeroed from upstream.
+  virtual void* allocate_zeroed(
+      std::size_t bytes, std::size_t alignment) override {
+    if (oversize(bytes, alignment)) {
+      void* p = state->upstream->allocate_zeroed(bytes, alignment);
+      ++large_misses;
+      large_bytes_live += bytes;
+      return p;
+    }
+    return memory_resource::allocate_zeroed(bytes, alignment);
+  }
+
+  virtual void deallocate(
+      void* p, std::size_t bytes, std::size_t alignment) override {
+    if (oversize(bytes, alignment)) {
+      state->upstream->deallocate(p, bytes, alignment);
+      large_bytes_live -= bytes;
+      return;
+    }
+
+    using cache = detail::pool_thread_cache;
+    auto index = state->index_of(bytes);
+    auto& list = cache::local().get(state)[index];
+    list.push_back(p);
+    state->classes[index].bytes_live -= state->block_size(index);
+    if (list.size() > cache::limit) {
+      cache::flush(*state, index, list, cache::batch);
+    }
+  }
+
+  // Returns blocks parked in the shared free lists to upstream. Blocks held
+  // in per-thread caches stay there until their thread exits.
+  void release() { state->release(); }
+
+  std::vector<pool_statistics> statistics() const {
+    std::vector<pool_statistics> ret;
+    for (std::size_t i = 0; i < state->classes.size(); ++i) {
+      auto& c = state->classes[i];
+      ret.push_back({state->block_size(i), c.hits, c.misses, c.bytes_live});
+    }
+    return ret;
+  }
+
+  pool_statistics large_statistics() const {
+    return {0, 0, large_misses, large_bytes_live};
+  }
+
+ private:
+  bool oversize(std::size_t bytes, std::size_t alignment) const {
+    auto max_block = state->block_size(state->classes.size() - 1);
+    return bytes > max_block || alignment > state->alignment;
+  }
+
+  std::shared_ptr<detail::pool_state> state;
+  std::atomic<std::size_t> large_misses{0};
+  std::atomic<std::size_t> large_bytes_live{0};
+};
+
+struct huge_page_statistics {
+  std::size_t mappings;
+  std::size_t bytes_mapped;
+  std::size_t bytes_huge;
+};
+
+namespace detail {
+
+// Sums AnonHugePages over the mappings in /proc/self/smaps that overlap
+// [first, last). Zero where smaps is unavailable.
+inline std::size_t huge_page_bytes(std::uintptr_t first, std::uintptr_t last) {
+  std::ifstream smaps("/proc/self/smaps");
+  std::string line;
+  bool inside = false;
+  std::size_t total = 0;
+  while (std::getline(smaps, line)) {
+    std::uintptr_t begin, end;
+    char dash;
+    std::istringstream range(line);
+    if (line.find(':') > line.find(' ') &&
+        (range >> std::hex >> begin >> dash >> end) && dash == '-') {
+      inside = begin < last && first < end;
+    } else if (inside && line.compare(0, 14, "AnonHugePages:") == 0) {
+      std::istringstream value(line.substr(14));
+      std::size_t kb = 0;
+      value >> kb;
+      total += kb * 1024;
+    }
+  }
+  return total;
+}
+
+}  // namespace detail
+
+// Bytes of the mapping containing `p` that are backed by transparent huge
+// pages, as reported by the kernel.
+inline std::size_t huge_page_bytes(const void* p) {
+  auto address = reinterpret_cast<std::uintptr_t>(p);
+  return detail::huge_page_bytes(address, address + 1);
+}
+
+// Large requests are served by anonymous mappings aligned to 2 MiB and
+// advised for transparent huge pages; with `prefault` every page is touched
+// up front so the first step does not take the faults. Requests below
+// `threshold` go to upstream. Whether the kernel actually backs a mapping
+// with huge pages depends on its THP settings; statistics() reports it.
+class huge_page_resource : public memory_resource {
+ public:
+  static constexpr std::size_t huge_page = std::size_t(1) << 21;
+
+  explicit huge_page_resource(
+      bool prefault = false,
+      std::size_t threshold = huge_page / 2,
+      memory_resource* upstream = new_delete_resource())
+      : prefault(prefault), threshold(threshold), upstream(upstream) {}
+
+  huge_page_resource(const huge_page_resource&) = delete;
+  huge_page_resource& operator=(const huge_page_resource&) = delete;
+
+  virtual void* allocate(std::size_t bytes, std::size_t alignment) override {
+    if (bytes < threshold || alignment > huge_page) {
+      return upstream->allocate(bytes, alignment);
+    }
+
+    auto length = round_up(bytes);
+    auto reserved = length + huge_page;
+    void* p = ::mmap(
+        nullptr,
+        reserved,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0);
+    if (p == MAP_FAILED) throw std::bad_alloc();
+
+    // Trim the reservation to a 2 MiB aligned range.
+    auto raw = reinterpret_cast<std::uintptr_t>(p);
+    auto aligned = (raw + huge_page - 1) & ~(huge_page - 1);
+    if (aligned != raw) ::munmap(p, aligned - raw);
+    auto tail = raw + reserved - (aligned + length);
+    if (tail != 0) {
+      ::munmap(reinterpret_cast<void*>(aligned + length), tail);
+    }
+    p = reinterpret_cast<void*>(aligned);
+
+#ifdef MADV_HUGEPAGE
+    ::madvise(p, length, MADV_HUGEPAGE);
+#endif  // MADV_HUGEPAGE
+
+    if (prefault) {
+      auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+      auto bytes = static_cast<volatile char*>(p);
+      for (std::size_t i = 0; i < length; i += page) bytes[i] = 0;
+    }
+
+    std::lock_guard<std::mutex> lock{mutex};
+    mappings.emplace(aligned, length);
+    return p;
+  }
+
+  // Fresh mappings are already zero.
+  virtual void* allocate_zeroed(
+      std::size_t bytes, std::size_t alignment) override {
+    if (bytes < threshold || alignment > huge_page) {
+      return upstream->allocate_zeroed(bytes, alignment);
+    }
+    return allocate(bytes, alignment);
+  }
+
+  virtual void deallocate(
+      void* p, std::size_t bytes, std::size_t alignment) override {
+    if (bytes < threshold || alignment > huge_page) {
+      upstream->deallocate(p, bytes, alignment);
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      mappings.erase(reinterpret_cast<std::uintptr_t>(p));
+    }
+    ::munmap(p, round_up(bytes));
+  }
+
+  huge_page_statistics statistics() const {
+    std::lock_guard<std::mutex> lock{mutex};
+    huge_page_statistics ret{mappings.size(), 0, 0};
+    for (auto& mapping : mappings) {
+      ret.bytes_mapped += mapping.second;
+      ret.bytes_huge += detail::huge_page_bytes(
+          mapping.first, mapping.first + mapping.second);
+    }
+    return ret;
+  }
+
+ private:
+  static std::size_t round_up(std::size_t bytes) {
+    return (std::max<std::size_t>(bytes, 1) + huge_page - 1) &
+           ~(huge_page - 1);
+  }
+
+  bool prefault;
+  std::size_t threshold;
+  memory_resource* upstream;
+
+  mutable std::mutex mutex;
+  std::map<std::uintptr_t, std::size_t> mappings;
+};
+
+namespace detail {
+
+inline std::atomic<memory_resource*>& default_resource_ref() {
+  static auto* pool = new pool_resource();
+  static std::atomic<memory_resource*> resource{pool};
+  return resource;
+}
+
+}  // namespace detail
+
+inline memory_resource* get_default_resource() {
+  return detail::default_resource_ref().load();
+}
+
+inline memory_resource* set_default_resource(memory_resource* r) {
+  return detail::default_resource_ref().exchange(
+      r == nullptr ? new_delete_resource() : r);
+}
+
+// Pool for buffer_info blocks and their shared_ptr control blocks.
+inline pool_resource* info_resource() {
+  static auto* pool = new pool_resource(256, 32, alignof(std::max_align_t));
+  return pool;
+}
+
+template <class T> class resource_allocator {
+ public:
+  using value_type = T;
+
+  resource_allocator(memory_resource* r = info_resource()) : resource(r) {}
+
+  template <class U>
+  resource_allocator(const resource_allocator<U>& other)
+      : resource(other.resource) {}
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(resource->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* p, std::size_t n) {
+    resource->deallocate(p, n * sizeof(T), alignof(T));
+  }
+
+  template <class U> friend class resource_allocator;
+
+  friend bool operator==(
+      const resource_allocator& lhs, const resource_allocator& rhs) {
+    return lhs.resource == rhs.resource;
+  }
+
+  friend bool operator!=(
+      const resource_allocator& lhs, const resource_allocator& rhs) {
+    return !(lhs == rhs);
+  }
+
+ private:
+  memory_resource* resource;
+};
+
+}  // namespace brica2
+
+#endif  // __BRICA2_MEMORY_HPP__
@@ -2,8 +2,10 @@
 #define __BRICA2_MPI_COMPONENT_HPP__
 
 #include "brica2/component.hpp"
+#include "brica2/events.hpp"
 #include "brica2/logger.hpp"
 #include "brica2/mpi/datatype.hpp"
+#include "brica2/view.hpp"
 
 #include <exception>
 #include <initializer_list>
@@ -11,6 +13,7 @@
 
 #include <string>
 #include <sstream>
+#include <type_traits>
 
 #include "mpi.h"
 
@@ -97,6 +100,34 @@ class component : public component_type {
     if (enabled()) base.make_out_port<T>(key, std::forward<S>(s));
   }
 
+  void make_in_port(const std::string& key, const buffer& prototype) {
+    if (enabled()) base.make_in_port(key, prototype);
+  }
+
+  void make_out_port(const std::string& key, const buffer& prototype) {
+    if (enabled()) base.make_out_port(key, prototype);
+  }
+
+  void set_buffering(std::size_t n) { base.set_buffering(n); }
+  void set_pure(bool p = true) { base.set_pure(p); }
+
+  virtual bool pure() const override { return base.pure(); }
+  virtual bool planned() const override { return base.planned(); }
+
+  virtual bool inputs_changed() const override {
+    return base.inputs_changed();
+  }
+
+  virtual std::vector<port*> input_ports() override {
+    if (enabled()) return base.input_ports();
+    return {};
+  }
+
+  virtual std::vector<port*> output_ports() override {
+    if (enabled()) return base.output_ports();
+    return {};
+  }
+
   port& get_in_port(const std::string& key) {
     if (enabled()) return base.get_in_port(key);
     throw bad_rank();
@@ -107,6 +138,16 @@ class component : public component_type {
     throw bad_rank();
   }
 
+  in_port_handle in_handle(const std::string& key) const {
+    if (enabled()) return base.in_handle(key);
+    throw bad_rank();
+  }
+
+  out_port_handle out_handle(const std::string& key) const {
+    if (enabled()) return base.out_handle(key);
+    throw bad_rank();
+  }
+
   buffer& get_input(const std::string& key) {
     if (enabled()) return get_input(key);
     throw bad_rank();
@@ -142,11 +183,19 @@ struct singular_io {
   virtual port& get_out_port() = 0;
 };
 
+// Point-to-point transfer of T[shape]. Integer elements may be quantized,
+// so for them each message is preceded by one carrying the parameters.
 template <class T> class proxy : public component_type, public singular_io {
  public:
   template <class S = std::initializer_list<ssize_t>>
   proxy(S&& s, int src, int dest, int tag = 1, MPI_Comm comm = MPI_COMM_WORLD)
-      : src(src), dest(dest), tag(tag), comm(comm), request(MPI_REQUEST_NULL) {
+      : src(src),
+        dest(dest),
+        tag(tag),
+        comm(comm),
+        ring(2),
+        request(MPI_REQUEST_NULL),
+        quant_request(MPI_REQUEST_NULL) {
     MPI_Comm_rank(comm, &rank);
     if (rank == src) setup_send(std::forward<S>(s));
     if (rank == dest) setup_recv(std::forward<S>(s));
@@ -164,9 +213,22 @@ template <class T> class proxy : public component_type, public singular_io {
     if (receiving()) return out_port;
     throw bad_rank();
   }
+
+  virtual std::vector<port*> input_ports() override {
+    if (sending()) return {&in_port};
+    return {};
+  }
+
+  virtual std::vector<port*> output_ports() override {
+    if (receiving()) return {&out_port};
+    return {};
+  }
   virtual void collect() override {
     if (sending()) {
-      std::memcpy(memory.data(), in_port.get().data(), memory.size_bytes());
+      // The wire format is packed; a strided view is gathered first.
+      auto content = ascontiguous(in_port.get());
+      std::memcpy(memory.data(), content.data(), memory.size_bytes());
+      quant = content.request().quant;
     }
   }
 
@@ -177,7 +239,10 @@ template <class T> class proxy : public component_type, public singular_io {
   virtual void expose() override {
     if (sending() || receiving()) wait();
     if (receiving()) {
-      std::memcpy(out_port.get().data(), memory.data(), memory.size_bytes());
+      auto out = ring.acquire(prototype);
+      std::memcpy(out.data(), memory.data(), memory.size_bytes());
+      out.request().quant = quant;
+      ring.recycle(out_port.set(std::move(out)));
     }
   }
 
@@ -192,11 +257,18 @@ template <class T> class proxy : public component_type, public singular_io {
     int error =
         MPI_Ssend_init(buf, count, datatype<T>(), dest, tag, comm, &request);
     handle_error("MPI_Send_init", error);
+
+    if (quantizable) {
+      error = MPI_Ssend_init(
+          &quant, sizeof(quant), MPI_BYTE, dest, tag, comm, &quant_request);
+      handle_error("MPI_Send_init", error);
+    }
   }
 
   template <class S> void setup_recv(S&& s) {
     memory = empty<T>(std::forward<S>(s));
     out_port = port(std::forward<S>(s), T());
+    prototype = prototype_of(out_port.get());
 
     void* buf = memory.data();
     int count = memory.size();
@@ -204,10 +276,31 @@ template <class T> class proxy : public component_type, public singular_io {
     int error =
         MPI_Recv_init(buf, count, datatype<T>(), src, tag, comm, &request);
     handle_error("MPI_Recv_init", error);
+
+    if (quantizable) {
+      error = MPI_Recv_init(
+          &quant, sizeof(quant), MPI_BYTE, src, tag, comm, &quant_request);
+      handle_error("MPI_Recv_init", error);
+    }
   }
 
-  void start() { handle_error("MPI_Start", MPI_Start(&request)); }
-  void wait() { handle_error("MPI_Wait", MPI_Wait(&request, &status)); }
+  // Both messages share the tag; started in the same order on either side,
+  // they cannot overtake each other.
+  void start() {
+    if (quantizable) {
+      handle_error("MPI_Start", MPI_Start(&quant_request));
+    }
+    handle_error("MPI_Start", MPI_Start(&request));
+  }
+
+  void wait() {
+    if (quantizable) {
+      handle_error("MPI_Wait", MPI_Wait(&quant_request, MPI_STATUS_IGNORE));
+    }
+    handle_error("MPI_Wait", MPI_Wait(&request, &status));
+  }
+
+  static constexpr bool quantizable = std::is_integral<T>::value;
 
   int src;
   int dest;
@@ -217,18 +310,32 @@ template <class T> class proxy : public component_type, public singular_io {
   port in_port;
   port out_port;
   buffer memory;
+  // Received contents are published in buffers of their own, since delay
+  // lines and consumers may still hold earlier ones.
+  buffer prototype;
+  buffer_ring ring;
+  quantization quant;
 
   int rank;
   MPI_Status status;
   MPI_Request request;
+  MPI_Request quant_request;
 };
 
+// Broadcast of T[shape] from `root`, with the quantization parameters of
+// integer elements ahead of the payload.
 template <class T, class S = std::initializer_list<ssize_t>>
 class broadcast : public component_type, public singular_io {
  public:
   broadcast(S&& s, int root, MPI_Comm comm = MPI_COMM_WORLD)
-      : root(root), comm(comm), memory(empty(std::forward<S>(s), T())) {
+      : root(root),
+        comm(comm),
+        memory(empty(std::forward<S>(s), T())),
+        prototype(prototype_of(memory)),
+        ring(2) {
     MPI_Comm_rank(comm, &rank);
+    if (sending()) in_port = port(zeros_like(memory));
+    if (receiving()) out_port = port(zeros_like(memory));
   }
 
   virtual bool sending() const override { return rank == root; }
@@ -236,15 +343,30 @@ class broadcast : public component_type, public singular_io {
 
   virtual port& get_in_port() override {
     if (sending()) return in_port;
+    throw bad_rank();
   }
 
   virtual port& get_out_port() override {
     if (receiving()) return out_port;
+    throw bad_rank();
+  }
+
+  virtual std::vector<port*> input_ports() override {
+    if (sending()) return {&in_port};
+    return {};
+  }
+
+  virtual std::vector<port*> output_ports() override {
+    if (receiving()) return {&out_port};
+    return {};
   }
 
   virtual void collect() override {
     if (sending()) {
-      std::memcpy(memory.data(), in_port.get().data(), memory.size_bytes());
+      // The wire format is packed; a strided view is gathered first.
+      auto content = ascontiguous(in_port.get());
+      std::memcpy(memory.data(), content.data(), memory.size_bytes());
+      quant = content.request().quant;
     }
   }
 
@@ -256,12 +378,19 @@ class broadcast : public component_type, public singular_io {
       logger::info("Call MPI_Bcast", count, rank, root);
     }
 #endif  // BRICA2_LOG_MPI
+    if (std::is_integral<T>::value) {
+      handle_error(
+          "MPI_Bcast", MPI_Bcast(&quant, sizeof(quant), MPI_BYTE, root, comm));
+    }
     handle_error("MPI_Bcast", MPI_Bcast(buf, count, datatype<T>(), root, comm));
   }
 
   virtual void expose() override {
     if (receiving()) {
-      std::memcpy(out_port.get().data(), memory.data(), memory.size_bytes());
+      auto out = ring.acquire(prototype);
+      std::memcpy(out.data(), memory.data(), memory.size_bytes());
+      out.request().quant = quant;
+      ring.recycle(out_port.set(std::move(out)));
     }
   }
 
@@ -272,6 +401,199 @@ class broadcast : public component_type, public singular_io {
   port in_port;
   port out_port;
   buffer memory;
+  // Received contents are published in buffers of their own, since delay
+  // lines and consumers may still hold earlier ones.
+  buffer prototype;
+  buffer_ring ring;
+  quantization quant;
+
+  int rank;
+};
+
+// Point-to-point transfer of an event buffer laid out like `prototype`.
+// Only the active events go over the wire, in a message sized to them.
+class event_proxy : public component_type, public singular_io {
+ public:
+  event_proxy(
+      const buffer& prototype,
+      int src,
+      int dest,
+      int tag = 1,
+      MPI_Comm comm = MPI_COMM_WORLD)
+      : src(src),
+        dest(dest),
+        tag(tag),
+        comm(comm),
+        ring(2),
+        request(MPI_REQUEST_NULL) {
+    Expects(prototype.request().events.sparse());
+    MPI_Comm_rank(comm, &rank);
+    auto words = brica2::detail::max_event_words(prototype.request());
+    if (rank == src || rank == dest) {
+      memory = empty<event_address>({ssize_t(words)});
+    }
+    if (rank == src) in_port = port(zeros_like(prototype));
+    if (rank == dest) out_port = port(zeros_like(prototype));
+    this->prototype = prototype_of(prototype);
+  }
+
+  virtual bool sending() const override { return rank == src; }
+  virtual bool receiving() const override { return rank == dest; }
+
+  virtual port& get_in_port() override {
+    if (sending()) return in_port;
+    throw bad_rank();
+  }
+
+  virtual port& get_out_port() override {
+    if (receiving()) return out_port;
+    throw bad_rank();
+  }
+
+  virtual std::vector<port*> input_ports() override {
+    if (sending()) return {&in_port};
+    return {};
+  }
+
+  virtual std::vector<port*> output_ports() override {
+    if (receiving()) return {&out_port};
+    return {};
+  }
+
+  virtual void collect() override {
+    if (sending()) {
+      count = brica2::detail::pack_events(
+          in_port.get(), memory.mutable_data<event_address>());
+    }
+  }
+
+  virtual void execute() override {
+    auto buf = memory.mutable_data<event_address>();
+    if (sending()) {
+      int error = MPI_Issend(
+          buf, int(count), MPI_UINT32_T, dest, tag, comm, &request);
+      handle_error("MPI_Issend", error);
+    }
+    if (receiving()) {
+      int error = MPI_Irecv(
+          buf, int(memory.size()), MPI_UINT32_T, src, tag, comm, &request);
+      handle_error("MPI_Irecv", error);
+    }
+  }
+
+  virtual void expose() override {
+    if (sending() || receiving()) {
+      handle_error("MPI_Wait", MPI_Wait(&request, MPI_STATUS_IGNORE));
+    }
+    if (receiving()) {
+      auto out = ring.acquire(prototype);
+      brica2::detail::unpack_events(
+          memory.as_span<event_address>().data(), out);
+      ring.recycle(out_port.set(std::move(out)));
+    }
+  }
+
+ private:
+  int src;
+  int dest;
+  int tag;
+  MPI_Comm comm;
+
+  port in_port;
+  port out_port;
+  buffer memory;
+  // Received contents are published in buffers of their own, since delay
+  // lines and consumers may still hold earlier ones.
+  buffer prototype;
+  buffer_ring ring;
+  std::size_t count = 0;
+
+  int rank;
+  MPI_Request request;
+};
+
+// Broadcast of an event buffer laid out like `prototype`: the number of
+// events first, then only the active events.
+class event_broadcast : public component_type, public singular_io {
+ public:
+  event_broadcast(
+      const buffer& prototype, int root, MPI_Comm comm = MPI_COMM_WORLD)
+      : root(root), comm(comm), ring(2) {
+    Expects(prototype.request().events.sparse());
+    MPI_Comm_rank(comm, &rank);
+    auto words = brica2::detail::max_event_words(prototype.request());
+    memory = empty<event_address>({ssize_t(words)});
+    rows = brica2::detail::event_rows(prototype.request());
+    if (sending()) in_port = port(zeros_like(prototype));
+    if (receiving()) out_port = port(zeros_like(prototype));
+    this->prototype = prototype_of(prototype);
+  }
+
+  virtual bool sending() const override { return rank == root; }
+  virtual bool receiving() const override { return rank != root; }
+
+  virtual port& get_in_port() override {
+    if (sending()) return in_port;
+    throw bad_rank();
+  }
+
+  virtual port& get_out_port() override {
+    if (receiving()) return out_port;
+    throw bad_rank();
+  }
+
+  virtual std::vector<port*> input_ports() override {
+    if (sending()) return {&in_port};
+    return {};
+  }
+
+  virtual std::vector<port*> output_ports() override {
+    if (receiving()) return {&out_port};
+    return {};
+  }
+
+  virtual void collect() override {
+    if (sending()) {
+      brica2::detail::pack_events(
+          in_port.get(), memory.mutable_data<event_address>());
+    }
+  }
+
+  virtual void execute() override {
+    auto buf = memory.mutable_data<event_address>();
+    handle_error("MPI_Bcast", MPI_Bcast(buf, 1, MPI_UINT32_T, root, comm));
+    int count = int(rows * buf[0]);
+#if BRICA2_LOG_MPI
+    if (logger::enabled()) {
+      logger::info("Call MPI_Bcast", count, rank, root);
+    }
+#endif  // BRICA2_LOG_MPI
+    Expects(std::size_t(count) < memory.size());
+    handle_error(
+        "MPI_Bcast", MPI_Bcast(buf + 1, count, MPI_UINT32_T, root, comm));
+  }
+
+  virtual void expose() override {
+    if (receiving()) {
+      auto out = ring.acquire(prototype);
+      brica2::detail::unpack_events(
+          memory.as_span<event_address>().data(), out);
+      ring.recycle(out_port.set(std::move(out)));
+    }
+  }
+
+ private:
+  int root;
+  MPI_Comm comm;
+
+  port in_port;
+  port out_port;
+  buffer memory;
+  // Received contents are published in buffers of their own, since delay
+  // lines and consumers may still hold earlier ones.
+  buffer prototype;
+  buffer_ring ring;
+  std::size_t rows;
 
   int rank;
 };
@@ -281,37 +603,27 @@ struct port_spec {
   std::string k;
 };
 
+// These route through brica2::connect(), so a fan-in target adds a source
+// instead of being rebound.
 inline void connect(port_spec&& source, port_spec&& target) {
   auto& source_port = source.c.get_out_port(source.k);
   auto& target_port = target.c.get_in_port(target.k);
 
-  if (!compatible(source_port.get(), target_port.get())) {
-    throw incompatible_exception();
-  }
-
-  target_port = source_port;
+  brica2::connect(source_port, target_port);
 }
 
 inline void connect(port_spec&& source, singular_io& target) {
   auto& source_port = source.c.get_out_port(source.k);
   auto& target_port = target.get_in_port();
 
-  if (!compatible(source_port.get(), target_port.get())) {
-    throw incompatible_exception();
-  }
-
-  target_port = source_port;
+  brica2::connect(source_port, target_port);
 }
 
 inline void connect(singular_io& source, port_spec&& target) {
   auto& source_port = source.get_out_port();
   auto& target_port = target.c.get_in_port(target.k);
 
-  if (!compatible(source_port.get(), target_port.get())) {
-    throw incompatible_exception();
-  }
-
-  target_port = source_port;
+  brica2::connect(source_port, target_port);
 }
 
 }  // namespace mpi
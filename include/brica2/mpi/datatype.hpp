@@ -1,6 +1,8 @@
 #ifndef __BRICA2_MPI_DATATYPE_HPP__
 #define __BRICA2_MPI_DATATYPE_HPP__
 
+#include "brica2/half.hpp"
+
 #include "mpi.h"
 
 namespace brica2 {
@@ -8,6 +10,7 @@ namespace mpi {
 
 template <class T> MPI_Datatype datatype();
 template <> MPI_Datatype datatype<char>() { return MPI_CHAR; }
+template <> MPI_Datatype datatype<signed char>() { return MPI_SIGNED_CHAR; }
 template <> MPI_Datatype datatype<short>() { return MPI_SHORT; }
 template <> MPI_Datatype datatype<int>() { return MPI_INT; }
 template <> MPI_Datatype datatype<long>() { return MPI_LONG; }
@@ -25,6 +28,11 @@ template <> MPI_Datatype datatype<unsigned long long>() {
   return MPI_UNSIGNED_LONG_LONG;
 }
 
+// MPI has no 16-bit floating point types. Moving the bit patterns as 16-bit
+// integers is exact, byte order included; they must not be reduced.
+template <> MPI_Datatype datatype<float16>() { return MPI_UINT16_T; }
+template <> MPI_Datatype datatype<bfloat16>() { return MPI_UINT16_T; }
+
 }  // namespace mpi
 }  // namespace brica2
 
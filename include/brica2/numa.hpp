@@ -0,0 +1,192 @@
+#ifndef __BRICA2_NUMA_HPP__
+#define __BRICA2_NUMA_HPP__
+
+#include "brica2/memory.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace brica2 {
+
+// CPUs grouped by NUMA node, from /sys/devices/system/node. Machines
+// without that information are treated as one node holding every CPU.
+class numa_topology {
+ public:
+  numa_topology() {
+    for (int node = 0;; ++node) {
+      std::ifstream list(
+          "/sys/devices/system/node/node" + std::to_string(node) +
+          "/cpulist");
+      if (!list) break;
+      std::string line;
+      std::getline(list, line);
+      if (std::size_t(node) >= nodes.size()) nodes.resize(node + 1);
+      nodes[node] = parse_cpulist(line);
+    }
+    nodes.erase(
+        std::remove_if(
+            nodes.begin(),
+            nodes.end(),
+            [](const std::vector<int>& cpus) { return cpus.empty(); }),
+        nodes.end());
+    if (nodes.empty()) {
+      nodes.emplace_back();
+      unsigned n = std::max(1u, std::thread::hardware_concurrency());
+      for (unsigned cpu = 0; cpu < n; ++cpu) nodes[0].push_back(cpu);
+    }
+  }
+
+  static const numa_topology& get() {
+    static numa_topology topology;
+    return topology;
+  }
+
+  std::size_t size() const { return nodes.size(); }
+  const std::vector<int>& cpus(std::size_t node) const { return nodes[node]; }
+
+  std::size_t node_of(int cpu) const {
+    for (std::size_t node = 0; node < nodes.size(); ++node) {
+      auto& cpus = nodes[node];
+      if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end()) return node;
+    }
+    return 0;
+  }
+
+  // Node of the CPU the calling thread is running on.
+  std::size_t current_node() const {
+    if (nodes.size() == 1) return 0;
+    int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : node_of(cpu);
+  }
+
+  static std::vector<int> parse_cpulist(const std::string& s) {
+    std::vector<int> ret;
+    std::istringstream in(s);
+    std::string range;
+    while (std::getline(in, range, ',')) {
+      int first, last;
+      char dash;
+      std::istringstream r(range);
+      if (!(r >> first)) continue;
+      last = (r >> dash >> last) ? last : first;
+      for (int cpu = first; cpu <= last; ++cpu) ret.push_back(cpu);
+    }
+    return ret;
+  }
+
+ private:
+  std::vector<std::vector<int>> nodes;
+};
+
+// Restricts `thread` to the CPUs of `node`. Returns false where affinity
+// cannot be set; the thread then keeps running wherever the OS puts it.
+inline bool bind_to_node(std::thread& thread, std::size_t node) {
+  auto& topology = numa_topology::get();
+  if (topology.size() == 1) return false;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : topology.cpus(node)) CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) ==
+         0;
+}
+
+// Places large blocks by first touch: each one is a fresh anonymous mapping
+// whose pages are written by the allocating thread, so they land on that
+// thread's node. Allocate from the worker that will use a buffer, e.g. by
+// enabling output buffering and running one warm-up step on a
+// numa_parallel executor. Small blocks go to upstream.
+class numa_resource : public memory_resource {
+ public:
+  explicit numa_resource(
+      std::size_t threshold = 64 * 1024,
+      memory_resource* upstream = get_default_resource())
+      : threshold(threshold),
+        upstream(upstream),
+        page(::sysconf(_SC_PAGESIZE)),
+        bytes(numa_topology::get().size(), 0) {}
+
+  numa_resource(const numa_resource&) = delete;
+  numa_resource& operator=(const numa_resource&) = delete;
+
+  virtual void* allocate(std::size_t n, std::size_t alignment) override {
+    if (n < threshold || alignment > page) {
+      return upstream->allocate(n, alignment);
+    }
+    auto length = round_up(n);
+    void* p = ::mmap(
+        nullptr,
+        length,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0);
+    if (p == MAP_FAILED) throw std::bad_alloc();
+    auto pages = static_cast<volatile char*>(p);
+    for (std::size_t i = 0; i < length; i += page) pages[i] = 0;
+
+    auto node = numa_topology::get().current_node();
+    std::lock_guard<std::mutex> lock{mutex};
+    blocks.emplace(p, node);
+    bytes[node] += length;
+    return p;
+  }
+
+  // Fresh mappings are already zero.
+  virtual void* allocate_zeroed(std::size_t n, std::size_t alignment) override {
+    if (n < threshold || alignment > page) {
+      return upstream->allocate_zeroed(n, alignment);
+    }
+    return allocate(n, alignment);
+  }
+
+  virtual void deallocate(
+      void* p, std::size_t n, std::size_t alignment) override {
+    if (n < threshold || alignment > page) {
+      upstream->deallocate(p, n, alignment);
+      return;
+    }
+    auto length = round_up(n);
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      auto it = blocks.find(p);
+      bytes[it->second] -= length;
+      blocks.erase(it);
+    }
+    ::munmap(p, length);
+  }
+
+  // Live bytes per node, indexed like numa_topology.
+  std::vector<std::size_t> bytes_per_node() const {
+    std::lock_guard<std::mutex> lock{mutex};
+    return bytes;
+  }
+
+ private:
+  std::size_t round_up(std::size_t n) const {
+    return (n + page - 1) / page * page;
+  }
+
+  std::size_t threshold;
+  memory_resource* upstream;
+  std::size_t page;
+
+  mutable std::mutex mutex;
+  std::map<void*, std::size_t> blocks;
+  std::vector<std::size_t> bytes;
+};
+
+}  // namespace brica2
+
+#endif  // __BRICA2_NUMA_HPP__
@@ -0,0 +1,246 @@
+#ifndef __BRICA2_PLANNER_HPP__
+#define __BRICA2_PLANNER_HPP__
+
+#include "brica2/buffer.hpp"
+#include "brica2/component.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+#include <cstring>
+
+namespace brica2 {
+
+// Offline placement of fixed-size blocks into one arena. Each block is live
+// over an inclusive interval of step-local time; blocks whose intervals are
+// disjoint may share addresses.
+class memory_plan {
+ public:
+  static constexpr std::size_t forever =
+      std::numeric_limits<std::size_t>::max();
+
+  memory_plan() : total(0), align(default_alignment), solved(false) {}
+
+  std::size_t add(
+      std::size_t bytes,
+      std::size_t alignment = default_alignment,
+      std::size_t first = 0,
+      std::size_t last = forever) {
+    Expects(detail::valid_alignment(alignment) && first <= last);
+    blocks.push_back({bytes, alignment, first, last, 0});
+    align = std::max(align, alignment);
+    solved = false;
+    return blocks.size() - 1;
+  }
+
+  // Blocks are placed in order of their first use, so blocks that are live
+  // together end up next to each other in the order they were added. Each
+  // goes into the lowest gap left by the overlapping blocks already placed.
+  void solve() {
+    std::vector<std::size_t> order(blocks.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(
+        order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+          return blocks[a].first < blocks[b].first;
+        });
+
+    std::vector<std::size_t> placed;
+    total = 0;
+    for (auto i : order) {
+      auto& block = blocks[i];
+
+      std::vector<std::size_t> live;
+      for (auto j : placed) {
+        if (overlaps(block, blocks[j])) live.push_back(j);
+      }
+      std::sort(live.begin(), live.end(), [this](auto a, auto b) {
+        return blocks[a].offset < blocks[b].offset;
+      });
+
+      std::size_t offset = 0;
+      for (auto j : live) {
+        offset = round_up(offset, block.alignment);
+        if (offset + block.bytes <= blocks[j].offset) break;
+        offset = std::max(offset, blocks[j].offset + blocks[j].bytes);
+      }
+      block.offset = round_up(offset, block.alignment);
+
+      total = std::max(total, block.offset + block.bytes);
+      placed.push_back(i);
+    }
+    solved = true;
+  }
+
+  std::size_t offset(std::size_t id) const {
+    Expects(solved);
+    return blocks.at(id).offset;
+  }
+
+  std::size_t size() const { return total; }
+  std::size_t alignment() const { return align; }
+  std::size_t count() const { return blocks.size(); }
+
+  // Sum of all block sizes, i.e. the footprint without any sharing.
+  std::size_t requested() const {
+    std::size_t sum = 0;
+    for (auto& block : blocks) sum += block.bytes;
+    return sum;
+  }
+
+ private:
+  struct block_t {
+    std::size_t bytes;
+    std::size_t alignment;
+    std::size_t first;
+    std::size_t last;
+    std::size_t offset;
+  };
+
+  static bool overlaps(const block_t& a, const block_t& b) {
+    return a.first <= b.last && b.first <= a.last;
+  }
+
+  static std::size_t round_up(std::size_t n, std::size_t alignment) {
+    return (n + alignment - 1) & ~(alignment - 1);
+  }
+
+  std::vector<block_t> blocks;
+  std::size_t total;
+  std::size_t align;
+  bool solved;
+};
+
+// One zero-filled allocation laid out by a solved memory_plan. Buffers
+// handed out by at() share ownership of the arena.
+class arena {
+ public:
+  arena() = default;
+
+  explicit arena(
+      const memory_plan& plan,
+      memory_resource* resource = get_default_resource())
+      : plan(plan) {
+    auto bytes = plan.size();
+    auto alignment = plan.alignment();
+    void* p = resource->allocate(bytes, alignment);
+    std::memset(p, 0, bytes);
+    memory.reset(p, [resource, bytes, alignment](void* p) {
+      resource->deallocate(p, bytes, alignment);
+    });
+  }
+
+  buffer at(std::size_t id, const layout& l) const {
+    auto p = static_cast<char*>(memory.get()) + plan.offset(id);
+    return buffer(l, p, memory);
+  }
+
+  void* data() const { return memory.get(); }
+  std::size_t size() const { return plan.size(); }
+
+ private:
+  memory_plan plan;
+  std::shared_ptr<void> memory;
+};
+
+// Places the output slots of every component in one arena. `phases` gives
+// the phase each component runs in under a multi_phase_scheduler, in the
+// order the components are given; without it they all run in one phase,
+// as under single_phase_scheduler. Lifetimes follow from the connections
+// made so far:
+//
+//  - An output read only by components in later phases is written and
+//    read within one step. It gets a single slot, live from its producer's
+//    phase to its last consumer's, which may share memory with outputs
+//    live in other phases. Outside that window its port content is not
+//    meaningful.
+//  - An output read in the next step, by a component in the same or an
+//    earlier phase, gets two slots: one written while the other is read.
+//  - An output nobody is connected to may be read from outside at any
+//    time and gets one slot of its own.
+//  - An output with a delay line or history on it gets a slot for each
+//    past content kept, plus the two above: one for the current content
+//    and one being written.
+//
+// Planned slots are handed out again without checking for readers, which
+// is only safe under the schedulers with a barrier between steps or
+// phases; dag_scheduler rejects components with planned outputs.
+template <class InputIt>
+arena plan_outputs(
+    InputIt first, InputIt last, std::vector<std::size_t> phases = {}) {
+  struct request_t {
+    basic_component* c;
+    std::size_t port;
+    std::vector<std::size_t> ids;
+  };
+
+  std::vector<basic_component*> components;
+  for (auto it = first; it != last; ++it) {
+    basic_component& c = *it;
+    components.push_back(&c);
+  }
+  phases.resize(components.size(), 0);
+
+  // The phases each out-port is read in, and its longest delay line.
+  std::unordered_map<const void*, std::vector<std::size_t>> readers;
+  std::unordered_map<const void*, std::size_t> delays;
+  for (std::size_t i = 0; i < components.size(); ++i) {
+    for (auto p : components[i]->input_ports()) {
+      for (auto& source : p->sources()) {
+        readers[source.source_id()].push_back(phases[i]);
+        auto& delay = delays[source.source_id()];
+        delay = std::max(delay, source.get_delay());
+      }
+    }
+  }
+
+  memory_plan plan;
+  std::vector<request_t> requests;
+  for (std::size_t n = 0; n < components.size(); ++n) {
+    auto& c = *components[n];
+    auto phase = phases[n];
+    for (std::size_t i = 0; i < c.out_port_count(); ++i) {
+      auto& port = c.out_port_at(i);
+      auto& content = port.get();
+      auto bytes = content.size_bytes();
+      auto alignment = content.alignment();
+      request_t request{&c, i, {}};
+      auto past = std::max(port.history_depth(), delays[port.source_id()]);
+      auto it = readers.find(port.source_id());
+      if (past != 0) {
+        for (std::size_t k = 0; k < past + 2; ++k) {
+          request.ids.push_back(plan.add(bytes, alignment));
+        }
+      } else if (it == readers.end()) {
+        request.ids.push_back(plan.add(bytes, alignment));
+      } else if (*std::min_element(it->second.begin(), it->second.end()) <=
+                 phase) {
+        request.ids.push_back(plan.add(bytes, alignment));
+        request.ids.push_back(plan.add(bytes, alignment));
+      } else {
+        auto end = *std::max_element(it->second.begin(), it->second.end());
+        request.ids.push_back(plan.add(bytes, alignment, phase, end));
+      }
+      requests.push_back(std::move(request));
+    }
+  }
+
+  plan.solve();
+  arena ret(plan);
+
+  for (auto& request : requests) {
+    const layout& l = request.c->out_port_at(request.port).get().request();
+    std::vector<buffer> slots;
+    for (auto id : request.ids) slots.push_back(ret.at(id, l));
+    request.c->place_output(request.port, std::move(slots));
+  }
+
+  return ret;
+}
+
+}  // namespace brica2
+
+#endif  // __BRICA2_PLANNER_HPP__
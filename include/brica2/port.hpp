@@ -1,29 +1,161 @@
 #ifndef __BRICA2_PORT_HPP__
 #define __BRICA2_PORT_HPP__
 
+#include "brica2/assert.hpp"
 #include "brica2/buffer.hpp"
 
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
 namespace brica2 {
 
+class port;
+
+using generation_t = std::uint64_t;
+
+namespace detail {
+
+// Generations come from one counter shared by all ports, so a port that
+// is rebound to another one never appears unchanged by accident.
+inline generation_t next_generation() {
+  static std::atomic<generation_t> counter(0);
+  return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+}  // namespace detail
+
+// Combines the contents of the sources of an in-port that accepts more
+// than one (see brica2/fan_in.hpp).
+struct port_merge {
+  virtual ~port_merge() {}
+  virtual void add_source(const port& source) = 0;
+  virtual std::size_t source_count() const = 0;
+  virtual std::vector<port> sources() const = 0;
+  // Changes whenever the content of any source does.
+  virtual generation_t generation() const = 0;
+  // The combined content for this step, laid out like `like`.
+  virtual buffer merge(const buffer& like) = 0;
+};
+
 class port {
  public:
   template <class T, class S = std::initializer_list<ssize_t>>
   port(S&& s, const T& type_hint = T())
-      : self(std::make_shared<impl>(std::forward<S>(s), type_hint)) {}
+      : self(std::make_shared<impl>(std::forward<S>(s), type_hint)),
+        delay(0) {}
+
+  // A port whose initial content is `content`, e.g. an event buffer.
+  explicit port(const buffer& content)
+      : self(std::make_shared<impl>(content)), delay(0) {}
 
-  port() = default;
+  port() : delay(0) {}
   port(const port&) = default;
   port(port&&) = default;
   port& operator=(const port&) = default;
   port& operator=(port&&) = default;
 
-  buffer& get() { return self->content; }
-  void set(const buffer& b) { self->content = b; }
-  void set(buffer&& b) { self->content = std::move(b); }
+  // The current content, or for a delayed port the content from `delay`
+  // steps back.
+  buffer& get() { return history(0); }
+
+  // Publishes the content for a new step. With history kept, the previous
+  // content moves into it: the slots hold buffer handles, so nothing is
+  // copied. Returns the buffer that dropped out of the port, which the
+  // producer may recycle.
+  buffer set(const buffer& b) {
+    auto ret = self->push();
+    self->content = b;
+    self->generation = detail::next_generation();
+    return ret;
+  }
+
+  buffer set(buffer&& b) {
+    auto ret = self->push();
+    self->content = std::move(b);
+    self->generation = detail::next_generation();
+    return ret;
+  }
+
+  // Changes every time content is set, so a consumer that remembers it can
+  // tell whether anything new arrived since it last looked. For a merging
+  // port it follows the sources instead.
+  generation_t generation() const {
+    return self->merger ? self->merger->generation() : self->generation;
+  }
+
+  // Publishes the current content once more, for a source that did not
+  // run this step, so that its delay lines still advance by one.
+  void repeat() {
+    auto b = self->content;
+    set(std::move(b));
+  }
+
+  // Marks content written into the current buffer in place as new.
+  void touch() { self->generation = detail::next_generation(); }
 
   template <class T, class S = std::initializer_list<ssize_t>>
   void reshape(S&& s) {
     self = std::make_shared<impl>(std::forward<S>(s), T());
+    delay = 0;
+  }
+
+  // Keeps at least the last `depth` contents before the one get() returns.
+  // Steps that are not there yet read as zeros.
+  void keep_history(std::size_t depth) { self->reserve(delay + depth); }
+  std::size_t history_depth() const { return self->slots.size() - delay; }
+
+  // The content from `age` steps before the one get() returns, which is
+  // age zero. A delay line looks back from its delay.
+  buffer& history(std::size_t age) {
+    age += delay;
+    return age == 0 ? self->content : self->past(age);
+  }
+
+  // What get() returns and the `n - 1` contents before it, newest first,
+  // e.g. for a component integrating over recent steps.
+  std::vector<buffer> window(std::size_t n) {
+    std::vector<buffer> ret;
+    ret.reserve(n);
+    for (std::size_t age = 0; age < n; ++age) ret.push_back(history(age));
+    return ret;
+  }
+
+  // A port sharing this one's source that sees it `steps` later, i.e. a
+  // delay line of that length. History is kept for it as needed.
+  port delayed(std::size_t steps) const {
+    self->reserve(delay + steps);
+    port ret(*this);
+    ret.delay += steps;
+    return ret;
+  }
+
+  std::size_t get_delay() const { return delay; }
+
+  // An in-port with a merge keeps the ports connected to it as sources
+  // instead of being rebound to one; merge() then publishes their combined
+  // content, once per step before it is read.
+  void set_merge(std::shared_ptr<port_merge> m) {
+    self->merger = std::move(m);
+  }
+
+  bool merging() const { return self && self->merger; }
+  void add_source(const port& source) { self->merger->add_source(source); }
+
+  // The ports this one reads from: the sources of a merging port, or else
+  // the port itself.
+  std::vector<port> sources() const {
+    if (merging()) return self->merger->sources();
+    return std::vector<port>{*this};
+  }
+
+  // Shared by every port bound to the same source, whatever its delay.
+  const void* source_id() const { return self.get(); }
+
+  void merge() {
+    if (self->merger->source_count() != 0) {
+      set(self->merger->merge(self->content));
+    }
   }
 
   friend bool operator==(const port&, const port&);
@@ -33,14 +165,53 @@ class port {
   struct impl {
     template <class T, class S = std::initializer_list<ssize_t>>
     impl(S&& s, const T& type_hint)
-        : content(fill(std::forward<S>(s), type_hint)) {}
+        : content(fill(std::forward<S>(s), type_hint)),
+          next(0),
+          generation(detail::next_generation()) {}
+    explicit impl(const buffer& b)
+        : content(b), next(0), generation(detail::next_generation()) {}
+
+    // `slots` is a ring of past contents; `next` is where the oldest one is
+    // and the one about to be replaced.
+    buffer push() {
+      if (slots.empty()) return std::move(content);
+      auto ret = std::move(slots[next]);
+      slots[next] = std::move(content);
+      next = (next + 1) % slots.size();
+      return ret;
+    }
+
+    buffer& past(std::size_t age) {
+      Expects(0 < age && age <= slots.size());
+      return slots[(next + slots.size() - age) % slots.size()];
+    }
+
+    void reserve(std::size_t depth) {
+      if (depth <= slots.size()) return;
+      // Oldest first: zeros for the steps not seen yet, then the ring.
+      std::vector<buffer> grown;
+      grown.reserve(depth);
+      auto zero = zeros_like(content);
+      grown.resize(depth - slots.size(), zero);
+      for (std::size_t i = 0; i < slots.size(); ++i) {
+        grown.push_back(std::move(slots[(next + i) % slots.size()]));
+      }
+      slots = std::move(grown);
+      next = 0;
+    }
+
     buffer content;
+    std::vector<buffer> slots;
+    std::size_t next;
+    generation_t generation;
+    std::shared_ptr<port_merge> merger;
   };
   std::shared_ptr<impl> self;
+  std::size_t delay;
 };
 
 inline bool operator==(const port& lhs, const port& rhs) {
-  return lhs.self == rhs.self;
+  return lhs.self == rhs.self && lhs.delay == rhs.delay;
 }
 inline bool operator!=(const port& lhs, const port& rhs) {
   return !(lhs == rhs);
@@ -0,0 +1,463 @@
+#ifndef __BRICA2_QUANTIZE_HPP__
+#define __BRICA2_QUANTIZE_HPP__
+
+#include "brica2/assert.hpp"
+#include "brica2/buffer.hpp"
+#include "brica2/kernels.hpp"
+#include "brica2/reductions.hpp"
+#include "brica2/simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace brica2 {
+namespace simd {
+
+template <class T> struct quantization_kernels {
+  void (*quantize)(
+      const float*, T*, std::size_t, float, float, float, float);
+  void (*dequantize)(const T*, float*, std::size_t, float, float);
+  std::int64_t (*dot)(const T*, const T*, std::size_t);
+  std::int64_t (*sum)(const T*, std::size_t);
+};
+
+namespace scalar {
+
+template <class T> struct ints {
+  static float widen(const T* p) { return float(*p); }
+  static void narrow(float v, T* p) { *p = T(v); }
+};
+
+template <class T>
+std::int64_t dot(const T* a, const T* b, std::size_t n) {
+  std::int64_t ret = 0;
+  for (std::size_t i = 0; i < n; ++i) ret += std::int32_t(a[i]) * b[i];
+  return ret;
+}
+
+template <class T> std::int64_t sum(const T* a, std::size_t n) {
+  std::int64_t ret = 0;
+  for (std::size_t i = 0; i < n; ++i) ret += a[i];
+  return ret;
+}
+
+}  // namespace scalar
+}  // namespace simd
+}  // namespace brica2
+
+#define BRICA2_SIMD_ISA scalar
+#include "brica2/simd/quantize.hpp"
+#undef BRICA2_SIMD_ISA
+
+#if BRICA2_SIMD_X86
+
+// The int8 dot products widen to int16 and use pmaddwd, which adds pairs of
+// products into int32 lanes. A lane gains at most 2^15 per instruction, so
+// the lanes are flushed into an int64 total every `block` elements.
+
+BRICA2_SIMD_BEGIN_SSE2
+namespace brica2 {
+namespace simd {
+namespace sse2 {
+
+template <class T> struct ints;
+
+template <> struct ints<signed char> {
+  static __m128 widen(const signed char* p) {
+    int bytes;
+    std::memcpy(&bytes, p, sizeof(bytes));
+    auto x = _mm_cvtsi32_si128(bytes);
+    x = _mm_unpacklo_epi16(_mm_unpacklo_epi8(x, x), _mm_unpacklo_epi8(x, x));
+    return _mm_cvtepi32_ps(_mm_srai_epi32(x, 24));
+  }
+  static void narrow(__m128 v, signed char* p) {
+    auto x = _mm_cvtps_epi32(v);
+    x = _mm_packs_epi32(x, x);
+    int bytes = _mm_cvtsi128_si32(_mm_packs_epi16(x, x));
+    std::memcpy(p, &bytes, sizeof(bytes));
+  }
+};
+
+template <> struct ints<short> {
+  static __m128 widen(const short* p) {
+    auto x = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+  }
+  static void narrow(__m128 v, short* p) {
+    auto x = _mm_cvtps_epi32(v);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packs_epi32(x, x));
+  }
+};
+
+inline std::int64_t horizontal_sum(__m128i acc) {
+  std::int32_t lanes[4];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+  return std::int64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+
+// The low and high halves of 16 int8 values, sign extended to int16.
+inline __m128i widen_low(__m128i x) {
+  return _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8);
+}
+
+inline __m128i widen_high(__m128i x) {
+  return _mm_srai_epi16(_mm_unpackhi_epi8(x, x), 8);
+}
+
+inline std::int64_t dot(
+    const signed char* a, const signed char* b, std::size_t n) {
+  const std::size_t block = 16 * 16384;
+  std::int64_t total = 0;
+  std::size_t i = 0;
+  while (i + 16 <= n) {
+    auto end = std::min(n - n % 16, i + block);
+    auto acc = _mm_setzero_si128();
+    for (; i < end; i += 16) {
+      auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+      auto y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(widen_low(x), widen_low(y)));
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(widen_high(x), widen_high(y)));
+    }
+    total += horizontal_sum(acc);
+  }
+  return total + scalar::dot(a + i, b + i, n - i);
+}
+
+inline std::int64_t sum(const signed char* a, std::size_t n) {
+  const std::size_t block = 16 * 16384;
+  const auto ones = _mm_set1_epi16(1);
+  std::int64_t total = 0;
+  std::size_t i = 0;
+  while (i + 16 <= n) {
+    auto end = std::min(n - n % 16, i + block);
+    auto acc = _mm_setzero_si128();
+    for (; i < end; i += 16) {
+      auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(widen_low(x), ones));
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(widen_high(x), ones));
+    }
+    total += horizontal_sum(acc);
+  }
+  return total + scalar::sum(a + i, n - i);
+}
+
+using scalar::dot;
+using scalar::sum;
+
+}  // namespace sse2
+}  // namespace simd
+}  // namespace brica2
+
+#define BRICA2_SIMD_ISA sse2
+#include "brica2/simd/quantize.hpp"
+#undef BRICA2_SIMD_ISA
+BRICA2_SIMD_END
+
+BRICA2_SIMD_BEGIN_AVX2
+namespace brica2 {
+namespace simd {
+namespace avx2 {
+
+template <class T> struct ints;
+
+template <> struct ints<signed char> {
+  static __m256 widen(const signed char* p) {
+    auto x = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+    return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(x));
+  }
+  static void narrow(__m256 v, signed char* p) {
+    auto x = _mm256_cvtps_epi32(v);
+    x = _mm256_packs_epi32(x, x);
+    x = _mm256_packs_epi16(x, x);
+    // Bytes 0-3 of each 128-bit lane hold the values, in order.
+    auto order = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+    x = _mm256_permutevar8x32_epi32(x, order);
+    _mm_storel_epi64(
+        reinterpret_cast<__m128i*>(p), _mm256_castsi256_si128(x));
+  }
+};
+
+template <> struct ints<short> {
+  static __m256 widen(const short* p) {
+    auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x));
+  }
+  static void narrow(__m256 v, short* p) {
+    auto x = _mm256_cvtps_epi32(v);
+    x = _mm256_permute4x64_epi64(_mm256_packs_epi32(x, x), 0xd8);
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(p), _mm256_castsi256_si128(x));
+  }
+};
+
+inline std::int64_t horizontal_sum(__m256i acc) {
+  std::int32_t lanes[8];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+  std::int64_t ret = 0;
+  for (auto v : lanes) ret += v;
+  return ret;
+}
+
+inline std::int64_t dot(
+    const signed char* a, const signed char* b, std::size_t n) {
+  const std::size_t block = 16 * 32768;
+  std::int64_t total = 0;
+  std::size_t i = 0;
+  while (i + 16 <= n) {
+    auto end = std::min(n - n % 16, i + block);
+    auto acc = _mm256_setzero_si256();
+    for (; i < end; i += 16) {
+      auto x = _mm256_cvtepi8_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+      auto y = _mm256_cvtepi8_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+      acc = _mm256_add_epi32(acc, _mm256_madd_epi16(x, y));
+    }
+    total += horizontal_sum(acc);
+  }
+  return total + scalar::dot(a + i, b + i, n - i);
+}
+
+inline std::int64_t sum(const signed char* a, std::size_t n) {
+  const std::size_t block = 16 * 32768;
+  const auto ones = _mm256_set1_epi16(1);
+  std::int64_t total = 0;
+  std::size_t i = 0;
+  while (i + 16 <= n) {
+    auto end = std::min(n - n % 16, i + block);
+    auto acc = _mm256_setzero_si256();
+    for (; i < end; i += 16) {
+      auto x = _mm256_cvtepi8_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+      acc = _mm256_add_epi32(acc, _mm256_madd_epi16(x, ones));
+    }
+    total += horizontal_sum(acc);
+  }
+  return total + scalar::sum(a + i, n - i);
+}
+
+using scalar::dot;
+using scalar::sum;
+
+}  // namespace avx2
+}  // namespace simd
+}  // namespace brica2
+
+#define BRICA2_SIMD_ISA avx2
+#include "brica2/simd/quantize.hpp"
+#undef BRICA2_SIMD_ISA
+BRICA2_SIMD_END
+
+// AVX-512F has no 16-bit multiply-add (that is AVX-512BW), so the int8 dot
+// products stay on the AVX2 ones.
+BRICA2_SIMD_BEGIN_AVX512
+namespace brica2 {
+namespace simd {
+namespace avx512 {
+
+constexpr __mmask16 all = 0xffff;
+
+template <class T> struct ints;
+
+template <> struct ints<signed char> {
+  static __m512 widen(const signed char* p) {
+    auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    return _mm512_maskz_cvtepi32_ps(all, _mm512_maskz_cvtepi8_epi32(all, x));
+  }
+  static void narrow(__m512 v, signed char* p) {
+    auto x = _mm512_maskz_cvtps_epi32(all, v);
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(p), _mm512_maskz_cvtsepi32_epi8(all, x));
+  }
+};
+
+template <> struct ints<short> {
+  static __m512 widen(const short* p) {
+    auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    return _mm512_maskz_cvtepi32_ps(all, _mm512_maskz_cvtepi16_epi32(all, x));
+  }
+  static void narrow(__m512 v, short* p) {
+    auto x = _mm512_maskz_cvtps_epi32(all, v);
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(p), _mm512_maskz_cvtsepi32_epi16(all, x));
+  }
+};
+
+using avx2::dot;
+using avx2::sum;
+
+}  // namespace avx512
+}  // namespace simd
+}  // namespace brica2
+
+#define BRICA2_SIMD_ISA avx512
+#include "brica2/simd/quantize.hpp"
+#undef BRICA2_SIMD_ISA
+BRICA2_SIMD_END
+
+#endif  // BRICA2_SIMD_X86
+
+namespace brica2 {
+namespace simd {
+
+template <class T>
+quantization_kernels<T> make_quantization_kernels(isa target) {
+#if BRICA2_SIMD_X86
+  switch (target) {
+    case isa::avx512: return avx512::make_quantization_kernels<T>();
+    case isa::avx2: return avx2::make_quantization_kernels<T>();
+    case isa::sse2: return sse2::make_quantization_kernels<T>();
+    default: break;
+  }
+#endif  // BRICA2_SIMD_X86
+  return scalar::make_quantization_kernels<T>();
+}
+
+// The quantization kernels for T (signed char or short) on the active
+// instruction set.
+template <class T> const quantization_kernels<T>& quantizations() {
+  static const quantization_kernels<T> tables[] = {
+      make_quantization_kernels<T>(isa::scalar),
+      make_quantization_kernels<T>(isa::sse2),
+      make_quantization_kernels<T>(isa::avx2),
+      make_quantization_kernels<T>(isa::avx512)};
+  return tables[static_cast<int>(active_isa())];
+}
+
+}  // namespace simd
+
+namespace detail {
+
+// Calls f(T()) for the quantized storage types.
+template <class F> decltype(auto) visit_quantized(format_code code, F&& f) {
+  Expects(code == 'b' || code == 'h');
+  if (code == 'h') return f(short());
+  return f((signed char)0);
+}
+
+// Real value of sum((a - za) * (b - zb)) from the integer dot product.
+template <class T>
+double affine_dot(
+    const T* a, quantization qa, const T* b, quantization qb, std::size_t n) {
+  auto& k = simd::quantizations<T>();
+  auto raw = k.dot(a, b, n);
+  if (qb.zero_point != 0) raw -= qb.zero_point * k.sum(a, n);
+  if (qa.zero_point != 0) raw -= qa.zero_point * k.sum(b, n);
+  raw += std::int64_t(n) * qa.zero_point * qb.zero_point;
+  return double(qa.scale) * qb.scale * raw;
+}
+
+}  // namespace detail
+
+// Affine parameters mapping the range of `a` (widened to include zero, so
+// that zero stays exact) onto the whole range of T.
+template <class T> quantization calibrate(const buffer& a) {
+  using limits = std::numeric_limits<T>;
+  double lo = std::min(0.0, amin(a));
+  double hi = std::max(0.0, amax(a));
+  quantization q;
+  if (hi == lo) {
+    q.scale = 1;
+    return q;
+  }
+  q.scale = float((hi - lo) / (double(limits::max()) - limits::min()));
+  auto zero_point = limits::min() - std::nearbyint(lo / q.scale);
+  q.zero_point = std::int32_t(std::min<double>(
+      std::max<double>(zero_point, limits::min()), limits::max()));
+  return q;
+}
+
+// Quantizes a float buffer into T (signed char or short) with `q`, which
+// the result carries in its layout. Values outside the range of T saturate.
+template <class T> buffer quantize(const buffer& a, quantization q) {
+  using limits = std::numeric_limits<T>;
+  static_assert(
+      std::is_same<T, signed char>::value || std::is_same<T, short>::value,
+      "quantized buffers hold signed char or short");
+  Expects(a.request().format == 'f');
+  Expects(q.quantized());
+  Expects(limits::min() <= q.zero_point && q.zero_point <= limits::max());
+  auto x = detail::packed(a);
+  auto out = empty<T>(x.request().shape);
+  out.request().quant = q;
+  simd::quantizations<T>().quantize(
+      detail::cdata<float>(x),
+      detail::mdata<T>(out),
+      out.size(),
+      1 / q.scale,
+      float(limits::min() - q.zero_point),
+      float(limits::max() - q.zero_point),
+      float(q.zero_point));
+  return out;
+}
+
+template <class T> buffer quantize(const buffer& a) {
+  return quantize<T>(a, calibrate<T>(a));
+}
+
+// The real values of a quantized buffer, as float.
+inline buffer dequantize(const buffer& a) {
+  auto q = a.request().quant;
+  Expects(q.quantized());
+  auto x = detail::packed(a);
+  auto out = empty<float>(x.request().shape);
+  detail::visit_quantized(x.request().format, [&](auto t) {
+    using T = decltype(t);
+    simd::quantizations<T>().dequantize(
+        detail::cdata<T>(x),
+        detail::mdata<float>(out),
+        out.size(),
+        q.scale,
+        float(q.zero_point));
+  });
+  return out;
+}
+
+// Dot product of two quantized buffers of the same dtype and shape, in real
+// units. The products are summed exactly in integers.
+inline double dot(const buffer& a, const buffer& b) {
+  if (!compatible(a, b)) throw incompatible_exception();
+  auto qa = a.request().quant, qb = b.request().quant;
+  Expects(qa.quantized() && qb.quantized());
+  auto x = detail::packed(a), y = detail::packed(b);
+  return detail::visit_quantized(x.request().format, [&](auto t) {
+    using T = decltype(t);
+    return detail::affine_dot(
+        detail::cdata<T>(x), qa, detail::cdata<T>(y), qb, x.size());
+  });
+}
+
+// w (m x n) times x (n), both quantized with the same dtype; the result is
+// a float buffer of m real values.
+inline buffer matvec(const buffer& w, const buffer& x) {
+  auto& wi = w.request();
+  auto& xi = x.request();
+  if (wi.ndim != 2 || xi.ndim != 1 || wi.shape[1] != xi.shape[0] ||
+      wi.format != xi.format) {
+    throw incompatible_exception();
+  }
+  Expects(wi.quant.quantized() && xi.quant.quantized());
+  auto pw = detail::packed(w), px = detail::packed(x);
+  std::size_t m = wi.shape[0], n = wi.shape[1];
+  auto out = empty<float>({ssize_t(m)});
+  auto dst = detail::mdata<float>(out);
+  detail::visit_quantized(wi.format, [&](auto t) {
+    using T = decltype(t);
+    auto rows = detail::cdata<T>(pw);
+    auto v = detail::cdata<T>(px);
+    for (std::size_t i = 0; i < m; ++i) {
+      dst[i] = float(
+          detail::affine_dot(rows + i * n, wi.quant, v, xi.quant, n));
+    }
+  });
+  return out;
+}
+
+}  // namespace brica2
+
+#endif  // __BRICA2_QUANTIZE_HPP__
@@ -0,0 +1,340 @@
+#ifndef __BRICA2_REDUCTIONS_HPP__
+#define __BRICA2_REDUCTIONS_HPP__
+
+#include "brica2/assert.hpp"
+#include "brica2/buffer.hpp"
+#include "brica2/kernels.hpp"
+#include "brica2/simd.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+
+namespace brica2 {
+namespace simd {
+
+// Accumulator lanes of the deterministic reductions, whatever the vector
+// width: a multiple of every width so each instruction set fills whole
+// registers.
+constexpr std::size_t reduction_lanes = 32;
+
+template <class T> struct reduction_kernels {
+  using reduce_type = T (*)(const T*, std::size_t);
+  using accumulate_type = void (*)(const T*, T*, std::size_t);
+
+  template <class F> struct set {
+    F sum;
+    F sum_abs;
+    F sum_squares;
+    F max;
+    F min;
+  };
+
+  set<reduce_type> fast;
+  set<reduce_type> deterministic;
+  set<accumulate_type> accumulate;
+};
+
+}  // namespace simd
+}  // namespace brica2
+
+BRICA2_SIMD_EXACT_BEGIN
+#define BRICA2_SIMD_ISA scalar
+#include "brica2/simd/reduction.hpp"
+#undef BRICA2_SIMD_ISA
+
+#if BRICA2_SIMD_X86
+BRICA2_SIMD_BEGIN_SSE2
+#define BRICA2_SIMD_ISA sse2
+#include "brica2/simd/reduction.hpp"
+#undef BRICA2_SIMD_ISA
+BRICA2_SIMD_END
+
+BRICA2_SIMD_BEGIN_AVX2
+#define BRICA2_SIMD_ISA avx2
+#include "brica2/simd/reduction.hpp"
+#undef BRICA2_SIMD_ISA
+BRICA2_SIMD_END
+
+BRICA2_SIMD_BEGIN_AVX512
+#define BRICA2_SIMD_ISA avx512
+#include "brica2/simd/reduction.hpp"
+#undef BRICA2_SIMD_ISA
+BRICA2_SIMD_END
+#endif  // BRICA2_SIMD_X86
+BRICA2_SIMD_EXACT_END
+
+namespace brica2 {
+namespace simd {
+
+template <class T>
+reduction_kernels<T> make_reduction_kernels(isa, std::false_type) {
+  return scalar::make_reduction_kernels<T>();
+}
+
+template <class T>
+reduction_kernels<T> make_reduction_kernels(isa target, std::true_type) {
+#if BRICA2_SIMD_X86
+  switch (target) {
+    case isa::avx512: return avx512::make_reduction_kernels<T>();
+    case isa::avx2: return avx2::make_reduction_kernels<T>();
+    case isa::sse2: return sse2::make_reduction_kernels<T>();
+    default: break;
+  }
+#endif  // BRICA2_SIMD_X86
+  return scalar::make_reduction_kernels<T>();
+}
+
+// The reduction kernels for T on the active instruction set.
+template <class T> const reduction_kernels<T>& reductions() {
+  static const reduction_kernels<T> tables[] = {
+      make_reduction_kernels<T>(isa::scalar, has_vector<T>()),
+      make_reduction_kernels<T>(isa::sse2, has_vector<T>()),
+      make_reduction_kernels<T>(isa::avx2, has_vector<T>()),
+      make_reduction_kernels<T>(isa::avx512, has_vector<T>())};
+  return tables[static_cast<int>(active_isa())];
+}
+
+}  // namespace simd
+
+// How sums are ordered. fast keeps as many partial sums as the vector units
+// like, so the last bits of a result vary between instruction sets.
+// deterministic always keeps simd::reduction_lanes partial sums and adds
+// them up in a fixed order, without fused multiply-adds, so results are
+// bitwise identical on every machine. Reductions run on the calling thread
+// and never depend on the executor. max, min and argmax are exact either
+// way.
+enum class reduction_mode { fast, deterministic };
+
+namespace detail {
+
+inline std::atomic<reduction_mode>& reduction_mode_ref() {
+  static std::atomic<reduction_mode> value{reduction_mode::fast};
+  return value;
+}
+
+}  // namespace detail
+
+inline reduction_mode active_reduction_mode() {
+  return detail::reduction_mode_ref().load();
+}
+
+// Returns the previous setting.
+inline reduction_mode set_reduction_mode(reduction_mode mode) {
+  return detail::reduction_mode_ref().exchange(mode);
+}
+
+namespace detail {
+
+enum class reduction { sum, sum_abs, sum_squares, max, min };
+
+inline bool is_sum(reduction r) {
+  return r != reduction::max && r != reduction::min;
+}
+
+template <class Set> auto select(const Set& set, reduction r) {
+  switch (r) {
+    case reduction::sum: return set.sum;
+    case reduction::sum_abs: return set.sum_abs;
+    case reduction::sum_squares: return set.sum_squares;
+    case reduction::max: return set.max;
+    default: return set.min;
+  }
+}
+
+template <class T> auto reduce_kernel(reduction r) {
+  auto& k = simd::reductions<T>();
+  return select(
+      active_reduction_mode() == reduction_mode::deterministic
+          ? k.deterministic
+          : k.fast,
+      r);
+}
+
+template <class T> auto accumulate_kernel(reduction r) {
+  return select(simd::reductions<T>().accumulate, r);
+}
+
+// Integers are summed in double, which is exact up to 2^53.
+inline buffer reduction_operand(const buffer& a, reduction r) {
+  auto x = packed(a);
+  auto format = x.request().format;
+  if (!is_sum(r) || format == 'f' || format == 'd') return x;
+  auto ret = empty<double>(x.request().shape);
+  auto dst = mdata<double>(ret);
+  visit_numeric(format, [&](auto t) {
+    using T = decltype(t);
+    auto src = cdata<T>(x);
+    std::copy(src, src + x.size(), dst);
+  });
+  return ret;
+}
+
+inline double reduce(const buffer& a, reduction r) {
+  auto x = reduction_operand(a, r);
+  Expects(is_sum(r) || x.size() > 0);
+  return visit_numeric(x.request().format, [&](auto t) {
+    using T = decltype(t);
+    return double(reduce_kernel<T>(r)(cdata<T>(x), x.size()));
+  });
+}
+
+// The packed operand seen as outer x n x inner, n being the extent of axis.
+struct axis_split {
+  axis_split(const layout& l, std::size_t axis)
+      : outer(product(l.shape.begin(), l.shape.begin() + axis)),
+        n(l.shape[axis]),
+        inner(product(l.shape.begin() + axis + 1, l.shape.end())) {}
+
+  std::size_t outer, n, inner;
+};
+
+inline buffer reduce(const buffer& a, std::size_t axis, reduction r) {
+  Expects(axis < std::size_t(a.request().ndim));
+  auto x = reduction_operand(a, r);
+  axis_split split(x.request(), axis);
+  Expects(is_sum(r) || split.n > 0);
+  auto shape = x.request().shape;
+  shape[axis] = 1;
+  return visit_numeric(x.request().format, [&](auto t) {
+    using T = decltype(t);
+    auto out = empty<T>(shape);
+    auto src = cdata<T>(x);
+    auto dst = mdata<T>(out);
+    if (split.inner == 1) {
+      auto f = reduce_kernel<T>(r);
+      for (std::size_t o = 0; o < split.outer; ++o) {
+        dst[o] = f(src + o * split.n, split.n);
+      }
+      return out;
+    }
+    // Rows along the axis are folded into the output one after another,
+    // vectorized across the inner extent.
+    auto f = accumulate_kernel<T>(r);
+    for (std::size_t o = 0; o < split.outer; ++o) {
+      auto acc = dst + o * split.inner;
+      auto row = src + o * split.n * split.inner;
+      std::size_t k = 0;
+      if (is_sum(r)) {
+        std::fill(acc, acc + split.inner, T(0));
+      } else {
+        std::copy(row, row + split.inner, acc);
+        k = 1;
+      }
+      for (; k < split.n; ++k) f(row + k * split.inner, acc, split.inner);
+    }
+    return out;
+  });
+}
+
+inline buffer elementwise_sqrt(buffer a) {
+  visit_numeric(a.request().format, [&](auto t) {
+    using T = decltype(t);
+    for (auto& v : a.template as_span<T>()) v = std::sqrt(v);
+  });
+  return a;
+}
+
+// Index of the first element equal to m, NaN matching NaN.
+template <class T>
+std::size_t find_first(const T* p, std::size_t n, std::size_t stride, T m) {
+  std::size_t i = 0;
+  if (m == m) {
+    while (i < n && !(p[i * stride] == m)) ++i;
+  } else {
+    while (i < n && p[i * stride] == p[i * stride]) ++i;
+  }
+  return i;
+}
+
+}  // namespace detail
+
+// Reductions over a whole buffer, any dtype and layout. Integer sums are
+// taken in double. max, min and argmax need at least one element; argmax
+// is the C order index of the first maximum. NaNs are not ordered: results
+// involving them are reproducible but otherwise unspecified.
+
+inline double sum(const buffer& a) {
+  return detail::reduce(a, detail::reduction::sum);
+}
+
+inline double amax(const buffer& a) {
+  return detail::reduce(a, detail::reduction::max);
+}
+
+inline double amin(const buffer& a) {
+  return detail::reduce(a, detail::reduction::min);
+}
+
+inline double l1_norm(const buffer& a) {
+  return detail::reduce(a, detail::reduction::sum_abs);
+}
+
+inline double l2_norm(const buffer& a) {
+  return std::sqrt(detail::reduce(a, detail::reduction::sum_squares));
+}
+
+inline std::size_t argmax(const buffer& a) {
+  auto x = detail::packed(a);
+  Expects(x.size() > 0);
+  return detail::visit_numeric(x.request().format, [&](auto t) {
+    using T = decltype(t);
+    auto p = detail::cdata<T>(x);
+    auto m = detail::reduce_kernel<T>(detail::reduction::max)(p, x.size());
+    return detail::find_first(p, x.size(), 1, m);
+  });
+}
+
+// The same along one axis, which is kept with extent 1 so the result
+// broadcasts against the operand. Sums and norms of integers come out as
+// double, everything else keeps the dtype; argmax gives ssize_t indices
+// along the axis.
+
+inline buffer sum(const buffer& a, std::size_t axis) {
+  return detail::reduce(a, axis, detail::reduction::sum);
+}
+
+inline buffer amax(const buffer& a, std::size_t axis) {
+  return detail::reduce(a, axis, detail::reduction::max);
+}
+
+inline buffer amin(const buffer& a, std::size_t axis) {
+  return detail::reduce(a, axis, detail::reduction::min);
+}
+
+inline buffer l1_norm(const buffer& a, std::size_t axis) {
+  return detail::reduce(a, axis, detail::reduction::sum_abs);
+}
+
+inline buffer l2_norm(const buffer& a, std::size_t axis) {
+  return detail::elementwise_sqrt(
+      detail::reduce(a, axis, detail::reduction::sum_squares));
+}
+
+inline buffer argmax(const buffer& a, std::size_t axis) {
+  auto x = detail::packed(a);
+  auto m = amax(x, axis);
+  detail::axis_split split(x.request(), axis);
+  auto out = empty<ssize_t>(m.request().shape);
+  auto dst = detail::mdata<ssize_t>(out);
+  detail::visit_numeric(x.request().format, [&](auto t) {
+    using T = decltype(t);
+    auto src = detail::cdata<T>(x);
+    auto max = detail::cdata<T>(m);
+    for (std::size_t o = 0; o < split.outer; ++o) {
+      for (std::size_t i = 0; i < split.inner; ++i) {
+        auto j = o * split.inner + i;
+        dst[j] = detail::find_first(
+            src + o * split.n * split.inner + i, split.n, split.inner, max[j]);
+      }
+    }
+  });
+  return out;
+}
+
+}  // namespace brica2
+
+#endif  // __BRICA2_REDUCTIONS_HPP__
@@ -6,6 +6,16 @@
 
 #include <queue>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace brica2 {
 
@@ -17,6 +27,38 @@ struct timing_t {
   duration_t sleep;
 };
 
+// How many component steps a scheduler ran, and how many it skipped
+// because a pure component's inputs had not changed.
+struct skip_stats {
+  std::size_t run = 0;
+  std::size_t skipped = 0;
+
+  double skip_rate() const {
+    auto total = run + skipped;
+    return total == 0 ? 0.0 : double(skipped) / double(total);
+  }
+};
+
+inline skip_stats operator+(skip_stats lhs, const skip_stats& rhs) {
+  lhs.run += rhs.run;
+  lhs.skipped += rhs.skipped;
+  return lhs;
+}
+
+namespace detail {
+
+// A delay line counts steps by the contents its source publishes, so a
+// component whose outputs keep history has to run every step.
+inline bool skippable(component_type* component) {
+  if (!component->pure() || component->inputs_changed()) return false;
+  for (auto p : component->output_ports()) {
+    if (p->history_depth() != 0) return false;
+  }
+  return true;
+}
+
+}  // namespace detail
+
 class single_phase_scheduler {
  public:
   single_phase_scheduler(executor_type& e) : executor(e) {}
@@ -27,17 +69,27 @@ class single_phase_scheduler {
     std::for_each(first, last, [&](auto& c) { add(c); });
   }
 
+  // A skipped component does not expose either, so its outputs keep their
+  // generation and pure consumers further down may be skipped as well.
   void step() {
-    std::vector<std::function<void(void)>> fs(components.size());
-    for (std::size_t i = 0; i < components.size(); ++i) {
-      auto component = components[i];
+    active.clear();
+    for (auto component : components) {
+      if (detail::skippable(component)) {
+        ++stats.skipped;
+      } else {
+        active.push_back(component);
+      }
+    }
+    stats.run += active.size();
+
+    for (auto component : active) {
       auto f = [component]() {
         component->collect();
         component->execute();
       };
 
       if (component->thread_safe()) {
-        executor.post(f);
+        executor.post(component, f);
       } else {
         f();
       }
@@ -45,12 +97,11 @@ class single_phase_scheduler {
 
     executor.sync();
 
-    for (std::size_t i = 0; i < components.size(); ++i) {
-      auto component = components[i];
+    for (auto component : active) {
       auto f = [component]() { component->expose(); };
 
       if (component->thread_safe()) {
-        executor.post(f);
+        executor.post(component, f);
       } else {
         f();
       }
@@ -59,9 +110,14 @@ class single_phase_scheduler {
     executor.sync();
   }
 
+  const skip_stats& get_stats() const { return stats; }
+  void reset_stats() { stats = skip_stats(); }
+
  private:
   std::vector<component_type*> components;
+  std::vector<component_type*> active;
   executor_type& executor;
+  skip_stats stats;
 };
 
 class multi_phase_scheduler {
@@ -79,13 +135,23 @@ class multi_phase_scheduler {
   }
 
   void step() {
-    for (auto phase : phases) phase.step();
+    for (auto& phase : phases) phase.step();
   }
 
   void step_phase(std::size_t i) {
     if (i < phases.size()) phases[i].step();
   }
 
+  skip_stats get_stats() const {
+    skip_stats ret;
+    for (auto& phase : phases) ret = ret + phase.get_stats();
+    return ret;
+  }
+
+  void reset_stats() {
+    for (auto& phase : phases) phase.reset_stats();
+  }
+
  private:
   std::vector<single_phase_scheduler> phases;
   executor_type& executor;
@@ -126,9 +192,11 @@ class virtual_time_scheduler {
     }
 
     for (auto component : asleep) {
+      // A component skipped when it woke up has nothing new to expose.
+      if (idle.erase(component) != 0) continue;
       auto f = [component]() { component->expose(); };
       if (component->thread_safe()) {
-        executor.post(f);
+        executor.post(component, f);
       } else {
         f();
       }
@@ -137,12 +205,18 @@ class virtual_time_scheduler {
     executor.sync();
 
     for (auto component : awake) {
+      if (detail::skippable(component)) {
+        idle.insert(component);
+        ++stats.skipped;
+        continue;
+      }
+      ++stats.run;
       auto f = [component]() {
         component->collect();
         component->execute();
       };
       if (component->thread_safe()) {
-        executor.post(f);
+        executor.post(component, f);
       } else {
         f();
       }
@@ -151,6 +225,9 @@ class virtual_time_scheduler {
     executor.sync();
   }
 
+  const skip_stats& get_stats() const { return stats; }
+  void reset_stats() { stats = skip_stats(); }
+
  private:
   struct event_t {
     component_type* component;
@@ -162,7 +239,463 @@ class virtual_time_scheduler {
   };
 
   std::priority_queue<event_t> event_queue;
+  std::unordered_set<component_type*> idle;
+  executor_type& executor;
+  skip_stats stats;
+};
+
+// Runs only the components with something to do: those a producer exposed
+// new content to in the previous step, plus any woken from outside, so the
+// cost of a step follows the active part of the network rather than its
+// size. Consumers are found by matching in-ports to the out-ports they are
+// bound to, so connect components before adding them. A delayed
+// connection wakes its consumer once the delay has passed, and an event
+// output with no events wakes nobody, which keeps quiet parts of a spiking
+// network asleep. Delay lines count steps, not runs: the out-ports that
+// keep history repeat their content in steps their component sleeps
+// through.
+class event_driven_scheduler {
+ public:
+  event_driven_scheduler(executor_type& e)
+      : executor(e), now(0), indexed(true) {}
+
+  // A component runs in the first step after it is added. A persistent one
+  // runs in every step, e.g. a source sampling the outside world.
+  void add(component_type& component, bool persistent = false) {
+    if (ids.count(&component) != 0) return;
+    ids.emplace(&component, nodes.size());
+    nodes.push_back({&component, persistent, {}, {}, 0});
+    schedule(nodes.size() - 1, 0);
+    indexed = false;
+  }
+
+  template <class InputIt>
+  void add(InputIt first, InputIt last, bool persistent = false) {
+    std::for_each(first, last, [&](auto& c) { add(c, persistent); });
+  }
+
+  // Runs an added component `steps` steps after the next one, e.g. when
+  // something outside the network changed its state.
+  void wake(component_type& component, std::size_t steps = 0) {
+    schedule(ids.at(&component), steps);
+  }
+
+  void step() {
+    if (!indexed) index();
+    ++now;
+    active.clear();
+    for (auto i : always) enqueue(i);
+    if (!calendar.empty()) {
+      for (auto i : calendar.front()) enqueue(i);
+      calendar.pop_front();
+    }
+    stats.run += active.size();
+    stats.skipped += nodes.size() - active.size();
+
+    for (auto i : active) {
+      auto component = nodes[i].component;
+      auto f = [component]() {
+        component->collect();
+        component->execute();
+      };
+      if (component->thread_safe()) {
+        executor.post(component, f);
+      } else {
+        f();
+      }
+    }
+
+    executor.sync();
+
+    for (auto i : active) {
+      auto& n = nodes[i];
+      for (std::size_t k = 0; k < n.outputs.size(); ++k) {
+        n.marks[k] = n.outputs[k]->generation();
+      }
+    }
+
+    for (auto i : active) {
+      auto component = nodes[i].component;
+      auto f = [component]() { component->expose(); };
+      if (component->thread_safe()) {
+        executor.post(component, f);
+      } else {
+        f();
+      }
+    }
+
+    executor.sync();
+
+    for (auto& line : lines) {
+      if (nodes[line.node].stamp != now) line.source->repeat();
+    }
+
+    // Only outputs exposed this step wake their consumers.
+    for (auto i : active) {
+      auto& n = nodes[i];
+      for (std::size_t k = 0; k < n.outputs.size(); ++k) {
+        auto p = n.outputs[k];
+        if (p->generation() == n.marks[k]) continue;
+        auto& content = p->get().request();
+        if (content.events.sparse() && content.events.count == 0) continue;
+        auto it = consumers.find(p->source_id());
+        if (it == consumers.end()) continue;
+        for (auto& c : it->second) schedule(c.node, c.delay);
+      }
+    }
+  }
+
+  // The number of components run in the last step.
+  std::size_t active_count() const { return active.size(); }
+
+  const skip_stats& get_stats() const { return stats; }
+  void reset_stats() { stats = skip_stats(); }
+
+ private:
+  struct node {
+    component_type* component;
+    bool persistent;
+    std::vector<port*> outputs;
+    // The generations of the outputs before the last expose.
+    std::vector<generation_t> marks;
+    std::size_t stamp;
+  };
+
+  struct consumer {
+    std::size_t node;
+    std::size_t delay;
+  };
+
+  struct delay_line {
+    std::size_t node;
+    port* source;
+  };
+
+  void index() {
+    consumers.clear();
+    always.clear();
+    lines.clear();
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+      auto component = nodes[i].component;
+      nodes[i].outputs = component->output_ports();
+      nodes[i].marks.resize(nodes[i].outputs.size());
+      if (nodes[i].persistent) always.push_back(i);
+      for (auto p : nodes[i].outputs) {
+        if (p->history_depth() != 0) lines.push_back({i, p});
+      }
+      for (auto p : component->input_ports()) {
+        for (auto& source : p->sources()) {
+          consumers[source.source_id()].push_back({i, source.get_delay()});
+        }
+      }
+    }
+    indexed = true;
+  }
+
+  // `steps` counts from the next step.
+  void schedule(std::size_t i, std::size_t steps) {
+    if (calendar.size() <= steps) calendar.resize(steps + 1);
+    calendar[steps].push_back(i);
+  }
+
+  void enqueue(std::size_t i) {
+    if (nodes[i].stamp == now) return;
+    nodes[i].stamp = now;
+    active.push_back(i);
+  }
+
+  std::vector<node> nodes;
+  std::unordered_map<component_type*, std::size_t> ids;
+  std::unordered_map<const void*, std::vector<consumer>> consumers;
+  std::vector<std::size_t> always;
+  std::vector<delay_line> lines;
+  std::deque<std::vector<std::size_t>> calendar;
+  std::vector<std::size_t> active;
+  executor_type& executor;
+  std::size_t now;
+  bool indexed;
+  skip_stats stats;
+};
+
+// What a dag_scheduler run achieved. `work` sums the time spent in the
+// components, `span` is the longest chain of dependent component calls,
+// and `elapsed` is the wall time of the run.
+struct dag_stats {
+  std::size_t steps = 0;
+  std::size_t tasks = 0;
+  std::chrono::nanoseconds work{0};
+  std::chrono::nanoseconds span{0};
+  std::chrono::nanoseconds elapsed{0};
+
+  // The average number of components running at once.
+  double parallelism() const {
+    return elapsed.count() == 0 ? 0.0 : double(work.count()) / elapsed.count();
+  }
+
+  // The most any executor could get out of this network, work over span.
+  double available_parallelism() const {
+    return span.count() == 0 ? 0.0 : double(work.count()) / span.count();
+  }
+};
+
+// Runs components as a dataflow over their connections instead of in
+// phases between barriers. A component collects as soon as the producers
+// of its inputs have exposed the previous step, and exposes once it has
+// executed and its consumers have collected what it exposed before, so
+// each step computes what single_phase_scheduler would. A consumer drops
+// its handles to what it read before in collect(), before it counts down
+// its producers' expose, so buffer rings reuse nothing still being read.
+// Components with outputs from plan_outputs() are rejected, as the plan
+// relies on barriers between steps. No step waits for
+// the whole network: a slow component only holds up its neighbours, and
+// parts of the network run steps ahead of others where connections allow.
+// Connect components before adding them. Components that are not thread
+// safe, e.g. MPI proxies, are handed back to the thread that called run(),
+// which runs them one at a time, those about to collect first. Tasks post
+// further tasks, which the serial, parallel and NUMA executors allow but
+// the OpenMP one does not.
+class dag_scheduler {
+ public:
+  dag_scheduler(executor_type& e)
+      : executor(e), completed(0), last(0), indexed(true) {}
+
+  // Components with planned outputs are rejected: a producer may write
+  // the next step while its consumers still read the last one.
+  void add(component_type& component) {
+    Expects(!component.planned());
+    nodes.emplace_back(&component, completed);
+    indexed = false;
+  }
+
+  template <class InputIt> void add(InputIt first, InputIt last) {
+    std::for_each(first, last, [&](auto& c) { add(c); });
+  }
+
+  void step() { run(1); }
+
+  // Runs `steps` steps with no barrier until all of them are done. If a
+  // component throws, nothing that depends on it starts, and run() waits
+  // for the tasks already started before rethrowing the first exception.
+  // The network is then left partway through a step.
+  void run(std::size_t steps) {
+    if (steps == 0 || nodes.empty()) return;
+    if (!indexed) index();
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    last = completed + steps;
+    work = 0;
+    span = 0;
+    tasks = 0;
+    pending = 0;
+    error = nullptr;
+    for (auto& n : nodes) {
+      n.expose_wait = n.consumers.size() + 1;
+      n.collect_ready = 0;
+      n.expose_ready = 0;
+    }
+    owner = std::this_thread::get_id();
+    for (std::size_t i = 0; i < nodes.size(); ++i) launch(i, false);
+    serve();
+    executor.sync();
+    if (error) std::rethrow_exception(error);
+    completed = last;
+
+    stats.steps = steps;
+    stats.tasks = tasks;
+    stats.work = std::chrono::nanoseconds(work);
+    stats.span = std::chrono::nanoseconds(span);
+    stats.elapsed = clock::now() - start;
+  }
+
+  // Measured over the last run.
+  const dag_stats& get_stats() const { return stats; }
+
+ private:
+  using clock = std::chrono::steady_clock;
+
+  // The dependencies of a component's next collect and next expose are
+  // counted down by the tasks they wait for; whoever counts the last one
+  // starts the task. `collect_ready` and `expose_ready` carry the longest
+  // path to the task so far, in nanoseconds.
+  struct node {
+    node(component_type* c, std::size_t done)
+        : component(c),
+          collect_wait(0),
+          expose_wait(0),
+          collect_ready(0),
+          expose_ready(0),
+          done(done) {}
+
+    component_type* component;
+    std::vector<std::size_t> producers;
+    std::vector<std::size_t> consumers;
+    std::atomic<std::size_t> collect_wait;
+    std::atomic<std::size_t> expose_wait;
+    std::atomic<std::int64_t> collect_ready;
+    std::atomic<std::int64_t> expose_ready;
+    std::size_t done;
+  };
+
+  void index() {
+    std::unordered_map<const void*, std::size_t> owners;
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+      nodes[i].producers.clear();
+      nodes[i].consumers.clear();
+      for (auto p : nodes[i].component->output_ports()) {
+        owners[p->source_id()] = i;
+      }
+    }
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+      auto& producers = nodes[i].producers;
+      for (auto p : nodes[i].component->input_ports()) {
+        for (auto& source : p->sources()) {
+          auto it = owners.find(source.source_id());
+          if (it != owners.end() && it->second != i) {
+            producers.push_back(it->second);
+          }
+        }
+      }
+      std::sort(producers.begin(), producers.end());
+      producers.erase(
+          std::unique(producers.begin(), producers.end()), producers.end());
+      for (auto p : producers) nodes[p].consumers.push_back(i);
+    }
+    indexed = true;
+  }
+
+  void collect(std::size_t i) {
+    auto& n = nodes[i];
+    auto path = n.collect_ready.exchange(0);
+    n.collect_wait = n.producers.size() + 1;
+    auto start = clock::now();
+    n.component->collect();
+    auto collected = elapsed(start);
+    for (auto p : n.producers) signal_expose(p, path + collected);
+    n.component->execute();
+    auto executed = elapsed(start);
+    work += executed;
+    signal_expose(i, path + executed);
+  }
+
+  void expose(std::size_t i) {
+    auto& n = nodes[i];
+    auto path = n.expose_ready.exchange(0);
+    n.expose_wait = n.consumers.size() + 1;
+    auto start = clock::now();
+    n.component->expose();
+    auto exposed = elapsed(start);
+    work += exposed;
+    path += exposed;
+    raise(span, path);
+    ++n.done;
+    for (auto c : n.consumers) signal_collect(c, path);
+    signal_collect(i, path);
+  }
+
+  void signal_collect(std::size_t i, std::int64_t path) {
+    auto& n = nodes[i];
+    raise(n.collect_ready, path);
+    if (n.collect_wait.fetch_sub(1) == 1 && n.done < last) launch(i, false);
+  }
+
+  void signal_expose(std::size_t i, std::int64_t path) {
+    auto& n = nodes[i];
+    raise(n.expose_ready, path);
+    if (n.expose_wait.fetch_sub(1) == 1) launch(i, true);
+  }
+
+  // Tasks of components that are not thread safe are handed back to run()
+  // unless this is its thread. So are tasks past a few levels of nesting,
+  // since executors that run tasks inline would otherwise nest one call
+  // per dependency.
+  void launch(std::size_t i, bool exposing) {
+    ++pending;
+    auto here = std::this_thread::get_id() == owner;
+    if (nesting() > 32 || (!nodes[i].component->thread_safe() && !here)) {
+      std::lock_guard<std::mutex> lock{handoff_mutex};
+      handed.emplace_back(i, exposing);
+      handoff.notify_one();
+      return;
+    }
+    dispatch(i, exposing);
+  }
+
+  void dispatch(std::size_t i, bool exposing) {
+    ++tasks;
+    auto task = [this, i, exposing]() {
+      ++nesting();
+      try {
+        exposing ? expose(i) : collect(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock{handoff_mutex};
+        if (!error) error = std::current_exception();
+      }
+      --nesting();
+      if (--pending == 0) {
+        std::lock_guard<std::mutex> lock{handoff_mutex};
+        handoff.notify_one();
+      }
+    };
+    if (nodes[i].component->thread_safe()) {
+      executor.post(nodes[i].component, task);
+    } else {
+      task();
+    }
+  }
+
+  // Runs the tasks handed back until no task is left anywhere. Collects
+  // go first: for MPI proxies they start transfers, which a blocking
+  // expose may be waiting for on another rank.
+  void serve() {
+    for (;;) {
+      std::pair<std::size_t, bool> task;
+      {
+        std::unique_lock<std::mutex> lock{handoff_mutex};
+        handoff.wait(lock, [this] { return !handed.empty() || pending == 0; });
+        if (handed.empty()) return;
+        auto it = std::find_if(
+            handed.begin(), handed.end(), [](auto& t) { return !t.second; });
+        if (it == handed.end()) it = handed.begin();
+        task = *it;
+        handed.erase(it);
+      }
+      dispatch(task.first, task.second);
+    }
+  }
+
+  static std::int64_t elapsed(clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               clock::now() - start)
+        .count();
+  }
+
+  static void raise(std::atomic<std::int64_t>& a, std::int64_t value) {
+    auto current = a.load();
+    while (current < value && !a.compare_exchange_weak(current, value)) {
+    }
+  }
+
+  static std::size_t& nesting() {
+    thread_local std::size_t depth = 0;
+    return depth;
+  }
+
+  std::deque<node> nodes;
   executor_type& executor;
+  std::size_t completed;
+  std::size_t last;
+  bool indexed;
+
+  std::atomic<std::int64_t> work;
+  std::atomic<std::int64_t> span;
+  std::atomic<std::size_t> tasks;
+  std::atomic<std::size_t> pending;
+  std::thread::id owner;
+  std::mutex handoff_mutex;
+  std::condition_variable handoff;
+  std::deque<std::pair<std::size_t, bool>> handed;
+  std::exception_ptr error;
+  dag_stats stats;
 };
 
 }  // namespace brica2
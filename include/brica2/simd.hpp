@@ -0,0 +1,448 @@
+#ifndef __BRICA2_SIMD_HPP__
+#define __BRICA2_SIMD_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define BRICA2_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define BRICA2_SIMD_X86 0
+#endif
+
+// Code between BRICA2_SIMD_BEGIN_<ISA> and BRICA2_SIMD_END is compiled for
+// that instruction set regardless of the compiler flags; it must only run
+// once active_isa() says the CPU supports it.
+#if BRICA2_SIMD_X86 && defined(__clang__)
+#define BRICA2_SIMD_BEGIN(features)                                          \
+  _Pragma(BRICA2_SIMD_STR(clang attribute push(                              \
+      __attribute__((target(features))), apply_to = function)))
+#define BRICA2_SIMD_END _Pragma("clang attribute pop")
+#elif BRICA2_SIMD_X86
+#define BRICA2_SIMD_BEGIN(features) \
+  _Pragma("GCC push_options") _Pragma(BRICA2_SIMD_STR(GCC target(features)))
+#define BRICA2_SIMD_END _Pragma("GCC pop_options")
+#endif
+#define BRICA2_SIMD_STR(x) #x
+
+#define BRICA2_SIMD_BEGIN_SSE2 BRICA2_SIMD_BEGIN("sse2")
+#define BRICA2_SIMD_BEGIN_AVX2 BRICA2_SIMD_BEGIN("avx2,fma,f16c")
+#define BRICA2_SIMD_BEGIN_AVX512 BRICA2_SIMD_BEGIN("avx512f,avx2,fma,f16c")
+
+// Inside BRICA2_SIMD_EXACT_BEGIN and BRICA2_SIMD_EXACT_END a multiply
+// followed by an add stays two rounded operations even where the target has
+// FMA, so kernels that must not depend on the instruction set can nest these
+// in any region. Clang only fuses within one expression, which vec<T> calls
+// never are.
+#if defined(__GNUC__) && !defined(__clang__)
+#define BRICA2_SIMD_EXACT_BEGIN \
+  _Pragma("GCC push_options") _Pragma("GCC optimize(\"fp-contract=off\")")
+#define BRICA2_SIMD_EXACT_END _Pragma("GCC pop_options")
+#else
+#define BRICA2_SIMD_EXACT_BEGIN
+#define BRICA2_SIMD_EXACT_END
+#endif
+
+namespace brica2 {
+namespace simd {
+
+enum class isa { scalar, sse2, avx2, avx512 };
+
+inline isa detected_isa() {
+  static const isa value = [] {
+#if BRICA2_SIMD_X86
+    __builtin_cpu_init();
+    bool avx2 = __builtin_cpu_supports("avx2") &&
+                __builtin_cpu_supports("fma") &&
+                __builtin_cpu_supports("f16c");
+    if (avx2 && __builtin_cpu_supports("avx512f")) return isa::avx512;
+    if (avx2) return isa::avx2;
+    if (__builtin_cpu_supports("sse2")) return isa::sse2;
+#endif
+    return isa::scalar;
+  }();
+  return value;
+}
+
+namespace detail {
+
+inline std::atomic<isa>& active_isa_ref() {
+  static std::atomic<isa> value{detected_isa()};
+  return value;
+}
+
+}  // namespace detail
+
+// The instruction set kernels dispatch to. Defaults to the best one the CPU
+// has; set_isa() can lower it (e.g. to compare against scalar code) but
+// never raise it beyond detected_isa(). Returns the previous setting.
+inline isa active_isa() { return detail::active_isa_ref().load(); }
+
+inline isa set_isa(isa value) {
+  value = std::min(value, detected_isa());
+  return detail::active_isa_ref().exchange(value);
+}
+
+inline const char* isa_name(isa value) {
+  switch (value) {
+    case isa::sse2: return "sse2";
+    case isa::avx2: return "avx2";
+    case isa::avx512: return "avx512";
+    default: return "scalar";
+  }
+}
+
+// One-lane "vector" with the same interface as the instruction set
+// specific ones below; used for tails and for element types without a
+// vector implementation. max() and min() pick operands like the x86
+// instructions do, so NaNs come out the same on every instruction set.
+namespace scalar {
+
+template <class T> struct vec {
+  using value_type = T;
+  using reg = T;
+  static constexpr std::size_t width = 1;
+
+  static reg load(const T* p) { return *p; }
+  static void store(T* p, reg v) { *p = v; }
+  static reg set1(T v) { return v; }
+  static reg add(reg a, reg b) { return a + b; }
+  static reg sub(reg a, reg b) { return a - b; }
+  static reg mul(reg a, reg b) { return a * b; }
+  static reg div(reg a, reg b) { return a / b; }
+  static reg fma(reg a, reg b, reg c) { return a * b + c; }
+  static reg max(reg a, reg b) { return a > b ? a : b; }
+  static reg min(reg a, reg b) { return a < b ? a : b; }
+  static reg abs(reg a) { return std::abs(a); }
+  static reg round(reg a) { return std::nearbyint(a); }
+  static reg pow2i(reg k) { return std::ldexp(T(1), int(k)); }
+};
+
+}  // namespace scalar
+
+}  // namespace simd
+}  // namespace brica2
+
+#if BRICA2_SIMD_X86
+
+// pow2i() builds 2^k for integral k by adding 2^mantissa_bits + bias, which
+// leaves k + bias in the low mantissa bits, and shifting that into the
+// exponent field. SSE2 has no rounding instruction, so its round() adds and
+// subtracts 1.5 * 2^mantissa_bits instead, which is exact for the range
+// exp() needs.
+
+BRICA2_SIMD_BEGIN_SSE2
+namespace brica2 {
+namespace simd {
+namespace sse2 {
+
+template <class T> struct vec;
+
+template <> struct vec<float> {
+  using value_type = float;
+  using reg = __m128;
+  static constexpr std::size_t width = 4;
+
+  static reg load(const float* p) { return _mm_loadu_ps(p); }
+  static void store(float* p, reg v) { _mm_storeu_ps(p, v); }
+  static reg set1(float v) { return _mm_set1_ps(v); }
+  static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+  static reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+  static reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+  static reg div(reg a, reg b) { return _mm_div_ps(a, b); }
+  static reg fma(reg a, reg b, reg c) { return add(mul(a, b), c); }
+  static reg max(reg a, reg b) { return _mm_max_ps(a, b); }
+  static reg min(reg a, reg b) { return _mm_min_ps(a, b); }
+  static reg abs(reg a) { return _mm_andnot_ps(set1(-0.0f), a); }
+  static reg round(reg a) {
+    auto magic = set1(12582912.0f);
+    return sub(add(a, magic), magic);
+  }
+  static reg pow2i(reg k) {
+    auto t = _mm_castps_si128(add(k, set1(8388735.0f)));
+    return _mm_castsi128_ps(_mm_slli_epi32(t, 23));
+  }
+};
+
+template <> struct vec<double> {
+  using value_type = double;
+  using reg = __m128d;
+  static constexpr std::size_t width = 2;
+
+  static reg load(const double* p) { return _mm_loadu_pd(p); }
+  static void store(double* p, reg v) { _mm_storeu_pd(p, v); }
+  static reg set1(double v) { return _mm_set1_pd(v); }
+  static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+  static reg sub(reg a, reg b) { return _mm_sub_pd(a, b); }
+  static reg mul(reg a, reg b) { return _mm_mul_pd(a, b); }
+  static reg div(reg a, reg b) { return _mm_div_pd(a, b); }
+  static reg fma(reg a, reg b, reg c) { return add(mul(a, b), c); }
+  static reg max(reg a, reg b) { return _mm_max_pd(a, b); }
+  static reg min(reg a, reg b) { return _mm_min_pd(a, b); }
+  static reg abs(reg a) { return _mm_andnot_pd(set1(-0.0), a); }
+  static reg round(reg a) {
+    auto magic = set1(6755399441055744.0);
+    return sub(add(a, magic), magic);
+  }
+  static reg pow2i(reg k) {
+    auto t = _mm_castpd_si128(add(k, set1(4503599627371519.0)));
+    return _mm_castsi128_pd(_mm_slli_epi64(t, 52));
+  }
+};
+
+// SSE2 has no 32-bit lane multiply, maximum or minimum (they came with
+// SSE4.1): mul() multiplies even and odd lanes into 64-bit products and
+// interleaves their low halves, and max() and min() select with a compare.
+template <> struct vec<std::int32_t> {
+  using value_type = std::int32_t;
+  using reg = __m128i;
+  static constexpr std::size_t width = 4;
+
+  static reg load(const std::int32_t* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  }
+  static void store(std::int32_t* p, reg v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+  }
+  static reg set1(std::int32_t v) { return _mm_set1_epi32(v); }
+  static reg add(reg a, reg b) { return _mm_add_epi32(a, b); }
+  static reg mul(reg a, reg b) {
+    auto even = _mm_mul_epu32(a, b);
+    auto odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(
+        _mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+        _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+  }
+  static reg fma(reg a, reg b, reg c) { return add(mul(a, b), c); }
+  static reg max(reg a, reg b) { return select(_mm_cmpgt_epi32(a, b), a, b); }
+  static reg min(reg a, reg b) { return select(_mm_cmplt_epi32(a, b), a, b); }
+
+  static reg select(reg mask, reg a, reg b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+  }
+};
+
+template <> struct vec<std::int16_t> {
+  using value_type = std::int16_t;
+  using reg = __m128i;
+  static constexpr std::size_t width = 8;
+
+  static reg load(const std::int16_t* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  }
+  static void store(std::int16_t* p, reg v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+  }
+  static reg set1(std::int16_t v) { return _mm_set1_epi16(v); }
+  static reg add(reg a, reg b) { return _mm_add_epi16(a, b); }
+  static reg mul(reg a, reg b) { return _mm_mullo_epi16(a, b); }
+  static reg fma(reg a, reg b, reg c) { return add(mul(a, b), c); }
+  static reg max(reg a, reg b) { return _mm_max_epi16(a, b); }
+  static reg min(reg a, reg b) { return _mm_min_epi16(a, b); }
+};
+
+}  // namespace sse2
+}  // namespace simd
+}  // namespace brica2
+BRICA2_SIMD_END
+
+BRICA2_SIMD_BEGIN_AVX2
+namespace brica2 {
+namespace simd {
+namespace avx2 {
+
+template <class T> struct vec;
+
+template <> struct vec<float> {
+  using value_type = float;
+  using reg = __m256;
+  static constexpr std::size_t width = 8;
+
+  static reg load(const float* p) { return _mm256_loadu_ps(p); }
+  static void store(float* p, reg v) { _mm256_storeu_ps(p, v); }
+  static reg set1(float v) { return _mm256_set1_ps(v); }
+  static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+  static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+  static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+  static reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+  static reg fma(reg a, reg b, reg c) { return _mm256_fmadd_ps(a, b, c); }
+  static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+  static reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+  static reg abs(reg a) { return _mm256_andnot_ps(set1(-0.0f), a); }
+  static reg round(reg a) {
+    return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  }
+  static reg pow2i(reg k) {
+    auto t = _mm256_castps_si256(add(k, set1(8388735.0f)));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(t, 23));
+  }
+};
+
+template <> struct vec<double> {
+  using value_type = double;
+  using reg = __m256d;
+  static constexpr std::size_t width = 4;
+
+  static reg load(const double* p) { return _mm256_loadu_pd(p); }
+  static void store(double* p, reg v) { _mm256_storeu_pd(p, v); }
+  static reg set1(double v) { return _mm256_set1_pd(v); }
+  static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+  static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+  static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+  static reg div(reg a, reg b) { return _mm256_div_pd(a, b); }
+  static reg fma(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+  static reg max(reg a, reg b) { return _mm256_max_pd(a, b); }
+  static reg min(reg a, reg b) { return _mm256_min_pd(a, b); }
+  static reg abs(reg a) { return _mm256_andnot_pd(set1(-0.0), a); }
+  static reg round(reg a) {
+    return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  }
+  static reg pow2i(reg k) {
+    auto t = _mm256_castpd_si256(add(k, set1(4503599627371519.0)));
+    return _mm256_castsi256_pd(_mm256_slli_epi64(t, 52));
+  }
+};
+
+template <> struct vec<std::int32_t> {
+  using value_type = std::int32_t;
+  using reg = __m256i;
+  static constexpr std::size_t width = 8;
+
+  static reg load(const std::int32_t* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  static void store(std::int32_t* p, reg v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+  }
+  static reg set1(std::int32_t v) { return _mm256_set1_epi32(v); }
+  static reg add(reg a, reg b) { return _mm256_add_epi32(a, b); }
+  static reg mul(reg a, reg b) { return _mm256_mullo_epi32(a, b); }
+  static reg fma(reg a, reg b, reg c) { return add(mul(a, b), c); }
+  static reg max(reg a, reg b) { return _mm256_max_epi32(a, b); }
+  static reg min(reg a, reg b) { return _mm256_min_epi32(a, b); }
+};
+
+template <> struct vec<std::int16_t> {
+  using value_type = std::int16_t;
+  using reg = __m256i;
+  static constexpr std::size_t width = 16;
+
+  static reg load(const std::int16_t* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  static void store(std::int16_t* p, reg v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+  }
+  static reg set1(std::int16_t v) { return _mm256_set1_epi16(v); }
+  static reg add(reg a, reg b) { return _mm256_add_epi16(a, b); }
+  static reg mul(reg a, reg b) { return _mm256_mullo_epi16(a, b); }
+  static reg fma(reg a, reg b, reg c) { return add(mul(a, b), c); }
+  static reg max(reg a, reg b) { return _mm256_max_epi16(a, b); }
+  static reg min(reg a, reg b) { return _mm256_min_epi16(a, b); }
+};
+
+}  // namespace avx2
+}  // namespace simd
+}  // namespace brica2
+BRICA2_SIMD_END
+
+// The masked forms with a full mask are used where the unmasked intrinsics
+// start from an undefined register, which GCC 12 reports as possibly
+// uninitialized once inlined.
+BRICA2_SIMD_BEGIN_AVX512
+namespace brica2 {
+namespace simd {
+namespace avx512 {
+
+template <class T> struct vec;
+
+template <> struct vec<float> {
+  using value_type = float;
+  using reg = __m512;
+  static constexpr std::size_t width = 16;
+  static constexpr __mmask16 all = 0xffff;
+
+  static reg load(const float* p) { return _mm512_loadu_ps(p); }
+  static void store(float* p, reg v) { _mm512_storeu_ps(p, v); }
+  static reg set1(float v) { return _mm512_set1_ps(v); }
+  static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+  static reg sub(reg a, reg b) { return _mm512_sub_ps(a, b); }
+  static reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+  static reg div(reg a, reg b) { return _mm512_div_ps(a, b); }
+  static reg fma(reg a, reg b, reg c) { return _mm512_fmadd_ps(a, b, c); }
+  static reg max(reg a, reg b) { return _mm512_mask_max_ps(a, all, a, b); }
+  static reg min(reg a, reg b) { return _mm512_mask_min_ps(a, all, a, b); }
+  static reg abs(reg a) { return _mm512_abs_ps(a); }
+  static reg round(reg a) {
+    return _mm512_mask_roundscale_ps(
+        a, all, a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  }
+  static reg pow2i(reg k) {
+    auto t = _mm512_castps_si512(add(k, set1(8388735.0f)));
+    return _mm512_castsi512_ps(_mm512_mask_slli_epi32(t, all, t, 23));
+  }
+};
+
+template <> struct vec<double> {
+  using value_type = double;
+  using reg = __m512d;
+  static constexpr std::size_t width = 8;
+  static constexpr __mmask8 all = 0xff;
+
+  static reg load(const double* p) { return _mm512_loadu_pd(p); }
+  static void store(double* p, reg v) { _mm512_storeu_pd(p, v); }
+  static reg set1(double v) { return _mm512_set1_pd(v); }
+  static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+  static reg sub(reg a, reg b) { return _mm512_sub_pd(a, b); }
+  static reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+  static reg div(reg a, reg b) { return _mm512_div_pd(a, b); }
+  static reg fma(reg a, reg b, reg c) { return _mm512_fmadd_pd(a, b, c); }
+  static reg max(reg a, reg b) { return _mm512_mask_max_pd(a, all, a, b); }
+  static reg min(reg a, reg b) { return _mm512_mask_min_pd(a, all, a, b); }
+  static reg abs(reg a) { return _mm512_abs_pd(a); }
+  static reg round(reg a) {
+    return _mm512_mask_roundscale_pd(
+        a, all, a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  }
+  static reg pow2i(reg k) {
+    auto t = _mm512_castpd_si512(add(k, set1(4503599627371519.0)));
+    return _mm512_castsi512_pd(_mm512_mask_slli_epi64(t, all, t, 52));
+  }
+};
+
+template <> struct vec<std::int32_t> {
+  using value_type = std::int32_t;
+  using reg = __m512i;
+  static constexpr std::size_t width = 16;
+  static constexpr __mmask16 all = 0xffff;
+
+  static reg load(const std::int32_t* p) { return _mm512_loadu_si512(p); }
+  static void store(std::int32_t* p, reg v) { _mm512_storeu_si512(p, v); }
+  static reg set1(std::int32_t v) { return _mm512_set1_epi32(v); }
+  static reg add(reg a, reg b) { return _mm512_add_epi32(a, b); }
+  static reg mul(reg a, reg b) { return _mm512_mullo_epi32(a, b); }
+  static reg fma(reg a, reg b, reg c) { return add(mul(a, b), c); }
+  static reg max(reg a, reg b) {
+    return _mm512_mask_max_epi32(a, all, a, b);
+  }
+  static reg min(reg a, reg b) {
+    return _mm512_mask_min_epi32(a, all, a, b);
+  }
+};
+
+// 16-bit lanes need AVX-512BW, so they stay in AVX2 registers.
+template <> struct vec<std::int16_t> : avx2::vec<std::int16_t> {};
+
+}  // namespace avx512
+}  // namespace simd
+}  // namespace brica2
+BRICA2_SIMD_END
+
+#endif  // BRICA2_SIMD_X86
+
+#endif  // __BRICA2_SIMD_HPP__
@@ -0,0 +1,152 @@
+// Elementwise kernels, written once against the vec<T> interface of
+// brica2/simd.hpp and compiled once per instruction set: kernels.hpp
+// includes this file inside each BRICA2_SIMD_BEGIN_<ISA> region with
+// BRICA2_SIMD_ISA naming that instruction set's namespace. There is
+// deliberately no include guard.
+
+#ifndef BRICA2_SIMD_ISA
+#error "define BRICA2_SIMD_ISA before including brica2/simd/elementwise.hpp"
+#endif  // BRICA2_SIMD_ISA
+
+namespace brica2 {
+namespace simd {
+namespace BRICA2_SIMD_ISA {
+
+template <class V> struct add_op {
+  using reg = typename V::reg;
+  reg operator()(reg a, reg b) const { return V::add(a, b); }
+};
+
+template <class V> struct mul_op {
+  using reg = typename V::reg;
+  reg operator()(reg a, reg b) const { return V::mul(a, b); }
+};
+
+template <class V> struct maximum_op {
+  using reg = typename V::reg;
+  reg operator()(reg a, reg b) const { return V::max(a, b); }
+};
+
+template <class V> struct fma_op {
+  using reg = typename V::reg;
+  reg operator()(reg a, reg b, reg c) const { return V::fma(a, b, c); }
+};
+
+template <class V> struct clamp_op {
+  using T = typename V::value_type;
+  using reg = typename V::reg;
+  clamp_op(T lo, T hi) : lo(V::set1(lo)), hi(V::set1(hi)) {}
+  reg operator()(reg x) const { return V::min(V::max(x, lo), hi); }
+  reg lo, hi;
+};
+
+template <class V> struct relu_op {
+  using T = typename V::value_type;
+  using reg = typename V::reg;
+  reg operator()(reg x) const { return V::max(x, V::set1(T(0))); }
+};
+
+// exp(x) = 2^k * exp(r) with k = round(x / ln 2) and |r| <= ln 2 / 2; exp(r)
+// is its Taylor series, long enough to reach the precision of T. Inputs are
+// clamped to the range where 2^k stays a normal number.
+template <class V> struct exp_op {
+  using T = typename V::value_type;
+  using reg = typename V::reg;
+
+  static constexpr bool single = sizeof(T) == 4;
+  static constexpr int terms = single ? 8 : 14;
+
+  reg operator()(reg x) const {
+    x = V::min(V::max(x, V::set1(T(single ? -87.3 : -708.3))),
+               V::set1(T(single ? 88.3 : 709.0)));
+    auto k = V::round(V::mul(x, V::set1(T(1.4426950408889634))));
+    auto r = V::fma(k, V::set1(T(-0.693145751953125)), x);
+    r = V::fma(k, V::set1(T(-1.4286068203094172321e-6)), r);
+    auto p = V::set1(inverse_factorial(terms - 1));
+    for (int i = terms - 2; i >= 0; --i) {
+      p = V::fma(p, r, V::set1(inverse_factorial(i)));
+    }
+    return V::mul(p, V::pow2i(k));
+  }
+
+  static constexpr T inverse_factorial(int n) {
+    return n <= 1 ? T(1) : inverse_factorial(n - 1) / T(n);
+  }
+};
+
+template <class V> struct sigmoid_op {
+  using T = typename V::value_type;
+  using reg = typename V::reg;
+  reg operator()(reg x) const {
+    auto one = V::set1(T(1));
+    auto e = exp_op<V>()(V::sub(V::set1(T(0)), x));
+    return V::div(one, V::add(one, e));
+  }
+};
+
+// The main loop runs on vec<T>, the remainder on the one-lane scalar::vec<T>
+// with the same operation.
+template <template <class> class Op, class T, class... Args>
+void unary(const T* a, T* out, std::size_t n, Args... args) {
+  using V = vec<T>;
+  using S = scalar::vec<T>;
+  Op<V> op(args...);
+  Op<S> tail(args...);
+  std::size_t i = 0;
+  for (; i + V::width <= n; i += V::width) {
+    V::store(out + i, op(V::load(a + i)));
+  }
+  for (; i < n; ++i) out[i] = tail(a[i]);
+}
+
+template <template <class> class Op, class T>
+void binary(const T* a, const T* b, T* out, std::size_t n) {
+  using V = vec<T>;
+  using S = scalar::vec<T>;
+  Op<V> op;
+  Op<S> tail;
+  std::size_t i = 0;
+  for (; i + V::width <= n; i += V::width) {
+    V::store(out + i, op(V::load(a + i), V::load(b + i)));
+  }
+  for (; i < n; ++i) out[i] = tail(a[i], b[i]);
+}
+
+template <template <class> class Op, class T>
+void ternary(const T* a, const T* b, const T* c, T* out, std::size_t n) {
+  using V = vec<T>;
+  using S = scalar::vec<T>;
+  Op<V> op;
+  Op<S> tail;
+  std::size_t i = 0;
+  for (; i + V::width <= n; i += V::width) {
+    V::store(out + i, op(V::load(a + i), V::load(b + i), V::load(c + i)));
+  }
+  for (; i < n; ++i) out[i] = tail(a[i], b[i], c[i]);
+}
+
+template <class T>
+typename elementwise_kernels<T>::unary_type sigmoid_kernel(std::true_type) {
+  return &unary<sigmoid_op, T>;
+}
+
+template <class T>
+typename elementwise_kernels<T>::unary_type sigmoid_kernel(std::false_type) {
+  return nullptr;
+}
+
+template <class T> elementwise_kernels<T> make_elementwise_kernels() {
+  elementwise_kernels<T> k;
+  k.add = &binary<add_op, T>;
+  k.mul = &binary<mul_op, T>;
+  k.max = &binary<maximum_op, T>;
+  k.fma = &ternary<fma_op, T>;
+  k.clamp = &unary<clamp_op, T, T, T>;
+  k.relu = &unary<relu_op, T>;
+  k.sigmoid = sigmoid_kernel<T>(std::is_floating_point<T>());
+  return k;
+}
+
+}  // namespace BRICA2_SIMD_ISA
+}  // namespace simd
+}  // namespace brica2
@@ -0,0 +1,70 @@
+// Quantization kernels, compiled once per instruction set like
+// brica2/simd/elementwise.hpp. The including region provides ints<T>, which
+// turns V::width integers of type T into a vec<float> register and back,
+// and the int8 dot() and sum() when it has vector versions of them. There
+// is deliberately no include guard.
+
+#ifndef BRICA2_SIMD_ISA
+#error "define BRICA2_SIMD_ISA before including brica2/simd/quantize.hpp"
+#endif  // BRICA2_SIMD_ISA
+
+namespace brica2 {
+namespace simd {
+namespace BRICA2_SIMD_ISA {
+
+// out = round(clamp(a / scale, lo, hi)) + zero_point, where lo and hi are
+// the limits of T less the zero point, so the rounded value always fits.
+// Clamping first also keeps NaNs out of the conversion: they become lo.
+template <class T>
+void quantize(
+    const float* a,
+    T* out,
+    std::size_t n,
+    float inverse_scale,
+    float lo,
+    float hi,
+    float zero_point) {
+  using V = vec<float>;
+  using S = scalar::vec<float>;
+  auto vi = V::set1(inverse_scale);
+  auto vlo = V::set1(lo);
+  auto vhi = V::set1(hi);
+  auto vz = V::set1(zero_point);
+  std::size_t i = 0;
+  for (; i + V::width <= n; i += V::width) {
+    auto v = V::min(V::max(V::mul(V::load(a + i), vi), vlo), vhi);
+    ints<T>::narrow(V::add(V::round(v), vz), out + i);
+  }
+  for (; i < n; ++i) {
+    auto v = S::min(S::max(S::mul(a[i], inverse_scale), lo), hi);
+    out[i] = T(S::add(S::round(v), zero_point));
+  }
+}
+
+// out = (a - zero_point) * scale
+template <class T>
+void dequantize(
+    const T* a, float* out, std::size_t n, float scale, float zero_point) {
+  using V = vec<float>;
+  using S = scalar::vec<float>;
+  auto vs = V::set1(scale);
+  auto vz = V::set1(zero_point);
+  std::size_t i = 0;
+  for (; i + V::width <= n; i += V::width) {
+    V::store(out + i, V::mul(V::sub(ints<T>::widen(a + i), vz), vs));
+  }
+  for (; i < n; ++i) out[i] = S::mul(S::sub(float(a[i]), zero_point), scale);
+}
+
+template <class T> quantization_kernels<T> make_quantization_kernels() {
+  quantization_kernels<T> k;
+  k.quantize = &quantize<T>;
+  k.dequantize = &dequantize<T>;
+  k.dot = &dot;
+  k.sum = &sum;
+  return k;
+}
+
+}  // namespace BRICA2_SIMD_ISA
+}  // namespace simd
+}  // namespace brica2
@@ -0,0 +1,141 @@
+// Reduction kernels, compiled once per instruction set like
+// brica2/simd/elementwise.hpp: reductions.hpp includes this file inside each
+// BRICA2_SIMD_BEGIN_<ISA> region with BRICA2_SIMD_ISA naming that
+// instruction set's namespace. There is deliberately no include guard.
+
+#ifndef BRICA2_SIMD_ISA
+#error "define BRICA2_SIMD_ISA before including brica2/simd/reduction.hpp"
+#endif  // BRICA2_SIMD_ISA
+
+namespace brica2 {
+namespace simd {
+namespace BRICA2_SIMD_ISA {
+
+// Each operation folds an element into an accumulator and combines two
+// accumulators; identity() is where accumulators start.
+template <class V> struct sum_op {
+  using T = typename V::value_type;
+  using reg = typename V::reg;
+  static T identity() { return T(0); }
+  reg operator()(reg acc, reg x) const { return V::add(acc, x); }
+  static reg combine(reg a, reg b) { return V::add(a, b); }
+};
+
+template <class V> struct sum_abs_op {
+  using T = typename V::value_type;
+  using reg = typename V::reg;
+  static T identity() { return T(0); }
+  reg operator()(reg acc, reg x) const { return V::add(acc, V::abs(x)); }
+  static reg combine(reg a, reg b) { return V::add(a, b); }
+};
+
+template <class V> struct sum_squares_op {
+  using T = typename V::value_type;
+  using reg = typename V::reg;
+  static T identity() { return T(0); }
+  reg operator()(reg acc, reg x) const { return V::add(acc, V::mul(x, x)); }
+  static reg combine(reg a, reg b) { return V::add(a, b); }
+};
+
+template <class V> struct max_op {
+  using T = typename V::value_type;
+  using reg = typename V::reg;
+  static T identity() {
+    using limits = std::numeric_limits<T>;
+    return limits::has_infinity ? -limits::infinity() : limits::lowest();
+  }
+  reg operator()(reg acc, reg x) const { return V::max(acc, x); }
+  static reg combine(reg a, reg b) { return V::max(a, b); }
+};
+
+template <class V> struct min_op {
+  using T = typename V::value_type;
+  using reg = typename V::reg;
+  static T identity() {
+    using limits = std::numeric_limits<T>;
+    return limits::has_infinity ? limits::infinity() : limits::max();
+  }
+  reg operator()(reg acc, reg x) const { return V::min(acc, x); }
+  static reg combine(reg a, reg b) { return V::min(a, b); }
+};
+
+// Element i is folded into accumulator lane i % Lanes; the lanes are then
+// combined pairwise, halving their number each round. With Lanes fixed the
+// order of operations, and so the result, does not depend on the vector
+// width.
+template <template <class> class Op, class T, std::size_t Lanes>
+T reduce(const T* a, std::size_t n) {
+  using V = vec<T>;
+  using S = scalar::vec<T>;
+  static_assert(Lanes % V::width == 0, "lanes must fill whole registers");
+  constexpr std::size_t regs = Lanes / V::width;
+  Op<V> op;
+  Op<S> tail;
+  typename V::reg acc[regs];
+  for (auto& r : acc) r = V::set1(Op<S>::identity());
+  std::size_t i = 0;
+  for (; i + Lanes <= n; i += Lanes) {
+    for (std::size_t r = 0; r < regs; ++r) {
+      acc[r] = op(acc[r], V::load(a + i + r * V::width));
+    }
+  }
+  T lanes[Lanes];
+  for (std::size_t r = 0; r < regs; ++r) {
+    V::store(lanes + r * V::width, acc[r]);
+  }
+  for (std::size_t j = 0; i < n; ++i, ++j) lanes[j] = tail(lanes[j], a[i]);
+  for (std::size_t half = Lanes / 2; half > 0; half /= 2) {
+    for (std::size_t j = 0; j < half; ++j) {
+      lanes[j] = Op<S>::combine(lanes[j], lanes[j + half]);
+    }
+  }
+  return lanes[0];
+}
+
+// acc[i] = op(acc[i], a[i]), for reducing along an axis that is not the
+// innermost one. Every lane is independent, so this is deterministic as is.
+template <template <class> class Op, class T>
+void accumulate(const T* a, T* acc, std::size_t n) {
+  using V = vec<T>;
+  using S = scalar::vec<T>;
+  Op<V> op;
+  Op<S> tail;
+  std::size_t i = 0;
+  for (; i + V::width <= n; i += V::width) {
+    V::store(acc + i, op(V::load(acc + i), V::load(a + i)));
+  }
+  for (; i < n; ++i) acc[i] = tail(acc[i], a[i]);
+}
+
+// Integer types only get max and min; reductions.hpp sums them in double.
+template <class T>
+void set_sum_kernels(reduction_kernels<T>& k, std::true_type) {
+  k.fast.sum = &reduce<sum_op, T, 4 * vec<T>::width>;
+  k.fast.sum_abs = &reduce<sum_abs_op, T, 4 * vec<T>::width>;
+  k.fast.sum_squares = &reduce<sum_squares_op, T, 4 * vec<T>::width>;
+  k.deterministic.sum = &reduce<sum_op, T, reduction_lanes>;
+  k.deterministic.sum_abs = &reduce<sum_abs_op, T, reduction_lanes>;
+  k.deterministic.sum_squares = &reduce<sum_squares_op, T, reduction_lanes>;
+  k.accumulate.sum = &accumulate<sum_op, T>;
+  k.accumulate.sum_abs = &accumulate<sum_abs_op, T>;
+  k.accumulate.sum_squares = &accumulate<sum_squares_op, T>;
+}
+
+template <class T>
+void set_sum_kernels(reduction_kernels<T>&, std::false_type) {}
+
+template <class T> reduction_kernels<T> make_reduction_kernels() {
+  reduction_kernels<T> k{};
+  k.fast.max = &reduce<max_op, T, 4 * vec<T>::width>;
+  k.fast.min = &reduce<min_op, T, 4 * vec<T>::width>;
+  k.deterministic.max = &reduce<max_op, T, reduction_lanes>;
+  k.deterministic.min = &reduce<min_op, T, reduction_lanes>;
+  k.accumulate.max = &accumulate<max_op, T>;
+  k.accumulate.min = &accumulate<min_op, T>;
+  set_sum_kernels(k, std::is_floating_point<T>());
+  return k;
+}
+
+}  // namespace BRICA2_SIMD_ISA
+}  // namespace simd
+}  // namespace brica2
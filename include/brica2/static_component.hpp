@@ -0,0 +1,172 @@
+#ifndef __BRICA2_STATIC_COMPONENT_HPP__
+#define __BRICA2_STATIC_COMPONENT_HPP__
+
+#include "brica2/buffer.hpp"
+#include "brica2/buffer_ring.hpp"
+#include "brica2/component.hpp"
+#include "brica2/port.hpp"
+#include "brica2/span.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace brica2 {
+
+// A port of a static_component: elements of type T in a fixed shape.
+template <class T, ssize_t... Dims> struct static_port {
+  static_assert(sizeof...(Dims) > 0, "static ports need a shape");
+  using value_type = T;
+
+  static constexpr std::size_t size() {
+    std::size_t ret = 1;
+    for (auto d : {Dims...}) ret *= std::size_t(d);
+    return ret;
+  }
+
+  static extents shape() { return extents{Dims...}; }
+};
+
+template <class... Ports> struct In {};
+template <class... Ports> struct Out {};
+
+template <class Functor, class Inputs, class Outputs> class static_component;
+
+// A component whose ports are fixed at compile time and addressed by
+// position. The functor is stored by value and called with a span per
+// input and output in port order, e.g.
+//
+//   auto f = [](span<const float> x, span<float> y) { ... };
+//   static_component<decltype(f), In<static_port<float, 3>>,
+//                    Out<static_port<float, 3>>> c(f);
+//
+// Layouts are checked by connect(). Since a port may also be set or
+// rebound directly, collect() compares the layout hash of each input with
+// the static one, and packs the input if a producer exposed a strided
+// view. Otherwise collect() and expose() only move buffer handles. Outputs
+// are recycled as in basic_component.
+template <class Functor, class... Is, class... Os>
+class static_component<Functor, In<Is...>, Out<Os...>>
+    : public component_type {
+ public:
+  static constexpr std::size_t in_count = sizeof...(Is);
+  static constexpr std::size_t out_count = sizeof...(Os);
+
+  explicit static_component(Functor f)
+      : functor(std::move(f)),
+        purity(false),
+        collected(false),
+        in_ports{{port(Is::shape(), typename Is::value_type())...}},
+        out_ports{{port(Os::shape(), typename Os::value_type())...}} {
+    for (std::size_t i = 0; i < in_count; ++i) {
+      inputs[i] = in_ports[i].get();
+      hashes[i] = inputs[i].request().hash;
+    }
+    for (std::size_t i = 0; i < out_count; ++i) {
+      outputs[i] = out_ports[i].get();
+    }
+  }
+
+  virtual bool thread_safe() const override { return true; }
+
+  void set_pure(bool p = true) { purity = p; }
+  virtual bool pure() const override { return purity; }
+
+  virtual bool inputs_changed() const override {
+    if (!collected) return true;
+    for (std::size_t i = 0; i < in_count; ++i) {
+      if (in_ports[i].generation() != seen[i]) return true;
+    }
+    return false;
+  }
+
+  virtual std::vector<port*> input_ports() override {
+    std::vector<port*> ret;
+    for (auto& p : in_ports) ret.push_back(&p);
+    return ret;
+  }
+
+  virtual std::vector<port*> output_ports() override {
+    std::vector<port*> ret;
+    for (auto& p : out_ports) ret.push_back(&p);
+    return ret;
+  }
+
+  template <std::size_t I> port& in_port() {
+    static_assert(I < in_count, "no such input");
+    return in_ports[I];
+  }
+
+  template <std::size_t I> port& out_port() {
+    static_assert(I < out_count, "no such output");
+    return out_ports[I];
+  }
+
+  template <std::size_t I> buffer& input() { return inputs[I]; }
+  template <std::size_t I> buffer& output() { return outputs[I]; }
+
+  virtual void collect() override {
+    collected = true;
+    for (std::size_t i = 0; i < in_count; ++i) {
+      seen[i] = in_ports[i].generation();
+      if (in_ports[i].merging()) in_ports[i].merge();
+      inputs[i] = in_ports[i].get();
+      // The functor's spans take the static shape on trust.
+      auto& l = inputs[i].request();
+      if (BRICA2_UNLIKELY(l.hash != hashes[i])) {
+        throw incompatible_exception();
+      }
+      if (BRICA2_UNLIKELY(!l.is_contiguous())) inputs[i] = copy(inputs[i]);
+    }
+  }
+
+  virtual void execute() override {
+    for (std::size_t i = 0; i < out_count; ++i) {
+      outputs[i] = rings[i].acquire(outputs[i]);
+    }
+    call(
+        std::make_index_sequence<in_count>(),
+        std::make_index_sequence<out_count>());
+  }
+
+  virtual void expose() override {
+    for (std::size_t i = 0; i < out_count; ++i) {
+      rings[i].recycle(out_ports[i].set(outputs[i]));
+    }
+  }
+
+ private:
+  template <std::size_t... I, std::size_t... O>
+  void call(std::index_sequence<I...>, std::index_sequence<O...>) {
+    functor(
+        span<const typename Is::value_type>(
+            static_cast<const typename Is::value_type*>(inputs[I].data()),
+            Is::size())...,
+        span<typename Os::value_type>(
+            static_cast<typename Os::value_type*>(outputs[O].data()),
+            Os::size())...);
+  }
+
+  Functor functor;
+  bool purity;
+  bool collected;
+  std::array<generation_t, in_count> seen;
+  std::array<port, in_count> in_ports;
+  std::array<port, out_count> out_ports;
+  std::array<buffer, in_count> inputs;
+  std::array<std::uint64_t, in_count> hashes;
+  std::array<buffer, out_count> outputs;
+  std::array<buffer_ring, out_count> rings;
+};
+
+// Deduces the functor type: make_static_component<In<...>, Out<...>>(f).
+template <class Inputs, class Outputs, class Functor>
+static_component<Functor, Inputs, Outputs> make_static_component(
+    Functor f) {
+  return static_component<Functor, Inputs, Outputs>(std::move(f));
+}
+
+}  // namespace brica2
+
+#endif  // __BRICA2_STATIC_COMPONENT_HPP__
@@ -0,0 +1,105 @@
+#ifndef __BRICA2_VIEW_HPP__
+#define __BRICA2_VIEW_HPP__
+
+#include "brica2/assert.hpp"
+#include "brica2/buffer.hpp"
+
+#include <algorithm>
+#include <initializer_list>
+#include <numeric>
+#include <vector>
+
+namespace brica2 {
+namespace detail {
+
+inline char* offset_ptr(const buffer& b, std::size_t axis, ssize_t index) {
+  auto& info = b.request();
+  return static_cast<char*>(info.ptr) + index * info.strides[axis];
+}
+
+}  // namespace detail
+
+// Elements [start, stop) of `axis`, every `step`-th one.
+inline buffer slice(
+    const buffer& b,
+    std::size_t axis,
+    ssize_t start,
+    ssize_t stop,
+    ssize_t step = 1) {
+  auto& info = b.request();
+  Expects(axis < info.shape.size() && step > 0);
+  Expects(0 <= start && start <= stop && stop <= info.shape[axis]);
+  layout l = info;
+  l.shape[axis] = (stop - start + step - 1) / step;
+  l.strides[axis] *= step;
+  l.rehash();
+  return b.view(l, detail::offset_ptr(b, axis, start));
+}
+
+// The sub-buffer at `index` along `axis`, with that axis removed.
+inline buffer select(const buffer& b, std::size_t axis, ssize_t index) {
+  auto& info = b.request();
+  Expects(axis < info.shape.size());
+  Expects(0 <= index && index < info.shape[axis]);
+  layout l = info;
+  std::vector<ssize_t> shape, strides;
+  for (std::size_t i = 0; i < info.shape.size(); ++i) {
+    if (i == axis) continue;
+    shape.push_back(info.shape[i]);
+    strides.push_back(info.strides[i]);
+  }
+  l.ndim = shape.size();
+  l.shape.assign(shape.begin(), shape.end());
+  l.strides.assign(strides.begin(), strides.end());
+  l.rehash();
+  return b.view(l, detail::offset_ptr(b, axis, index));
+}
+
+// Permutes the axes; axis i of the result is axis axes[i] of `b`.
+template <class S = std::initializer_list<std::size_t>>
+buffer transpose(const buffer& b, S&& axes) {
+  auto& info = b.request();
+  Expects(std::distance(axes.begin(), axes.end()) == info.ndim);
+  std::vector<bool> seen(info.ndim, false);
+  layout l = info;
+  std::size_t i = 0;
+  for (auto axis : axes) {
+    Expects(axis < std::size_t(info.ndim) && !seen[axis]);
+    seen[axis] = true;
+    l.shape[i] = info.shape[axis];
+    l.strides[i] = info.strides[axis];
+    ++i;
+  }
+  l.rehash();
+  return b.view(l, info.ptr);
+}
+
+inline buffer transpose(const buffer& b) {
+  std::vector<std::size_t> axes(b.request().ndim);
+  std::iota(axes.rbegin(), axes.rend(), 0);
+  return transpose(b, axes);
+}
+
+// Reinterprets a contiguous buffer with a new shape of the same size.
+template <class S = std::initializer_list<ssize_t>>
+buffer reshape(const buffer& b, S&& s) {
+  auto& info = b.request();
+  Expects(b.is_contiguous());
+  layout l = info;
+  l.ndim = std::distance(s.begin(), s.end());
+  l.shape.assign(s.begin(), s.end());
+  auto size = detail::product(l.shape.begin(), l.shape.end());
+  Expects(std::size_t(size) == b.size());
+  l.strides = l.contiguous_strides();
+  l.rehash();
+  return b.view(l, info.ptr);
+}
+
+// `b` itself if already contiguous, a packed copy otherwise.
+inline buffer ascontiguous(const buffer& b) {
+  return b.is_contiguous() ? b : copy(b);
+}
+
+}  // namespace brica2
+
+#endif  // __BRICA2_VIEW_HPP__
@@ -1,7 +1,10 @@
 #include "brica2/buffer.hpp"
+#include "brica2/view.hpp"
 #include "catch.hpp"
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 
 TEST_CASE("generators", "[buffer]") {
@@ -55,3 +58,184 @@ TEST_CASE("generators", "[buffer]") {
     REQUIRE(!brica2::compatible(b1, b2));
   }
 }
+
+inline bool aligned(const brica2::buffer& b, std::size_t alignment) {
+  return reinterpret_cast<std::uintptr_t>(b.data()) % alignment == 0;
+}
+
+TEST_CASE("alignment", "[buffer]") {
+  SECTION("default alignment") {
+    auto b0 = brica2::empty<char>({1});
+    auto b1 = brica2::fill<double>({3, 5}, 1.0);
+    REQUIRE(b0.alignment() == brica2::default_alignment);
+    REQUIRE(b1.request().alignment == brica2::default_alignment);
+    REQUIRE(aligned(b0, brica2::default_alignment));
+    REQUIRE(aligned(b1, brica2::default_alignment));
+  }
+
+  SECTION("requested alignment") {
+    auto b0 = brica2::empty<float>({100}, float(), 4096);
+    auto b1 = brica2::fill<float>({3}, 1.0f, 128);
+    REQUIRE(b0.alignment() == 4096);
+    REQUIRE(b1.alignment() == 128);
+    REQUIRE(aligned(b0, 4096));
+    REQUIRE(aligned(b1, 128));
+  }
+
+  SECTION("empty_like and zeros_like") {
+    auto b = brica2::empty<float>({100}, float(), 256);
+    auto b0 = brica2::empty_like(b);
+    auto b1 = brica2::zeros_like(b, 512);
+    REQUIRE(b0.alignment() == 256);
+    REQUIRE(b1.alignment() == 512);
+    REQUIRE(aligned(b0, 256));
+    REQUIRE(aligned(b1, 512));
+  }
+}
+
+TEST_CASE("layout", "[buffer]") {
+  SECTION("dtype codes") {
+    REQUIRE(brica2::empty<float>({1}).request().format.value == 'f');
+    REQUIRE(brica2::empty<double>({1}).request().format.value == 'd');
+    REQUIRE(brica2::empty<int>({1}).request().format == "i");
+    REQUIRE(brica2::FormatDescriptor<unsigned char>::code() == 'B');
+  }
+
+  SECTION("layout hash") {
+    auto b0 = brica2::empty<float>({2, 3});
+    auto b1 = brica2::empty<float>({2, 3});
+    auto b2 = brica2::empty<float>({3, 2});
+    auto b3 = brica2::empty<int>({2, 3});
+    REQUIRE(b0.request().hash == b1.request().hash);
+    REQUIRE(b0.request().hash != b2.request().hash);
+    REQUIRE(b0.request().hash != b3.request().hash);
+    REQUIRE(brica2::empty_like(b0).request().hash == b0.request().hash);
+  }
+
+  SECTION("copies are plain") {
+    brica2::layout l = brica2::empty<float>({2, 3, 4}).request();
+    brica2::layout m;
+    std::memcpy(&m, &l, sizeof(l));
+    REQUIRE(brica2::compatible(l, m));
+  }
+
+  SECTION("rank is bounded") {
+    std::vector<brica2::ssize_t> shape(brica2::max_rank + 1, 1);
+    REQUIRE_THROWS_AS(brica2::empty<float>(shape), brica2::fail_fast);
+  }
+}
+
+TEST_CASE("views", "[buffer]") {
+  // 0 1 2 3
+  // 4 5 6 7
+  // 8 9 10 11
+  auto b = brica2::with<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}, {3, 4});
+  auto at = [](const brica2::buffer& v, brica2::ssize_t i, brica2::ssize_t j) {
+    auto& info = v.request();
+    auto p = static_cast<const char*>(info.ptr);
+    return *reinterpret_cast<const int*>(
+        p + i * info.strides[0] + j * info.strides[1]);
+  };
+
+  SECTION("slice") {
+    auto v = brica2::slice(b, 1, 1, 4, 2);
+    REQUIRE(v.request().shape == brica2::extents({3, 2}));
+    REQUIRE(!v.is_contiguous());
+    REQUIRE(at(v, 0, 0) == 1);
+    REQUIRE(at(v, 0, 1) == 3);
+    REQUIRE(at(v, 2, 1) == 11);
+
+    auto rows = brica2::slice(b, 0, 1, 3);
+    REQUIRE(rows.is_contiguous());
+    REQUIRE(rows.as_span<int>()[0] == 4);
+  }
+
+  SECTION("select") {
+    auto row = brica2::select(b, 0, 2);
+    auto col = brica2::select(b, 1, 1);
+    REQUIRE(row.request().ndim == 1);
+    REQUIRE(row.is_contiguous());
+    REQUIRE(row.as_span<int>()[3] == 11);
+    REQUIRE(!col.is_contiguous());
+    REQUIRE(brica2::ascontiguous(col).as_span<int>()[2] == 9);
+  }
+
+  SECTION("transpose") {
+    auto t = brica2::transpose(b);
+    REQUIRE(t.request().shape == brica2::extents({4, 3}));
+    REQUIRE(at(t, 3, 1) == 7);
+    auto c = brica2::ascontiguous(t);
+    REQUIRE(c.is_contiguous());
+    auto span = c.as_span<int>();
+    std::vector<int> expected = {0, 4, 8, 1, 5, 9, 2, 6, 10, 3, 7, 11};
+    REQUIRE(std::equal(span.begin(), span.end(), expected.begin()));
+  }
+
+  SECTION("reshape") {
+    auto r = brica2::reshape(b, {2, 6});
+    REQUIRE(r.data() == b.data());
+    REQUIRE(at(r, 1, 0) == 6);
+    REQUIRE_THROWS_AS(brica2::reshape(b, {5}), brica2::fail_fast);
+    REQUIRE_THROWS_AS(
+        brica2::reshape(brica2::transpose(b), {12}), brica2::fail_fast);
+  }
+
+  SECTION("views share the allocation") {
+    auto v = brica2::select(b, 0, 1);
+    auto p = b.data();
+    b = brica2::buffer();
+    REQUIRE(v.use_count() == 1);
+    REQUIRE(v.as_span<int>()[0] == 4);
+    REQUIRE(v.data() == static_cast<char*>(p) + 4 * sizeof(int));
+  }
+
+  SECTION("views are compatible with packed buffers") {
+    auto col = brica2::select(b, 1, 0);
+    REQUIRE(brica2::compatible(col, brica2::empty<int>({3})));
+    REQUIRE(brica2::empty_like(col).is_contiguous());
+  }
+}
+
+TEST_CASE("copy on write", "[buffer]") {
+  auto b = brica2::fill({4}, 1.0f);
+
+  SECTION("unique buffers are written in place") {
+    REQUIRE(b.unique());
+    auto p = b.data();
+    REQUIRE(b.mutable_data<float>() == p);
+  }
+
+  SECTION("shared buffers are copied first") {
+    auto a = b;
+    REQUIRE_FALSE(a.unique());
+    auto p = a.mutable_data<float>();
+    REQUIRE(p != b.data());
+    REQUIRE(a.unique());
+    REQUIRE(b.unique());
+    p[0] = 2.0f;
+    REQUIRE(b.as_span<float>()[0] == 1.0f);
+    REQUIRE(a.alignment() == b.alignment());
+  }
+
+  SECTION("views count their parent") {
+    auto v = brica2::slice(b, 0, 1, 4, 2);
+    REQUIRE_FALSE(v.unique());
+    b = brica2::buffer();
+    REQUIRE(v.unique());
+
+    auto w = brica2::slice(v, 0, 0, 1);
+    REQUIRE_FALSE(v.unique());
+    auto p = w.mutable_data<float>();
+    REQUIRE(w.is_contiguous());
+    p[0] = 3.0f;
+    REQUIRE(*static_cast<float*>(v.data()) == 1.0f);
+  }
+
+  SECTION("strided views are packed by the copy") {
+    auto v = brica2::slice(b, 0, 0, 4, 2);
+    auto p = v.mutable_data<float>();
+    REQUIRE(v.is_contiguous());
+    REQUIRE(v.size() == 2);
+    REQUIRE(p[1] == 1.0f);
+  }
+}
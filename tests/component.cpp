@@ -1,7 +1,9 @@
 #include "catch.hpp"
 #include "brica2/component.hpp"
+#include "brica2/view.hpp"
 
 #include <algorithm>
+#include <type_traits>
 #include <vector>
 #include <cstring>
 
@@ -106,3 +108,344 @@ TEST_CASE("constant/identity/discard component chain", "[component]") {
   CHECK(equal(c2.get_out_port(key).get(), value));
   CHECK(equal(c3.get_in_port(key).get(), value));
 }
+
+TEST_CASE("buffered outputs reuse storage across steps", "[component]") {
+  std::string key = "default";
+  std::vector<brica2::ssize_t> shape({3});
+
+  brica2::functor_type count = [key](const auto& inputs, auto& outputs) {
+    auto span = outputs[key].template as_span<float>();
+    std::fill(span.begin(), span.end(), 1.0f);
+  };
+  brica2::functor_type discard = [](const auto& inputs, auto& outputs) {};
+
+  brica2::component c1(count);
+  brica2::component c2(discard);
+
+  c1.make_out_port<float>(key, shape);
+  c2.make_in_port<float>(key, shape);
+  c1.set_buffering(2);
+
+  brica2::connect({c1, key}, {c2, key});
+
+  auto step = [&]() {
+    c1.collect();
+    c2.collect();
+    c1.execute();
+    c2.execute();
+    c1.expose();
+    c2.expose();
+  };
+
+  step();
+  void* p0 = c1.get_output(key).data();
+  step();
+  void* p1 = c1.get_output(key).data();
+  step();
+  void* p2 = c1.get_output(key).data();
+  step();
+  void* p3 = c1.get_output(key).data();
+
+  CHECK(p0 != p1);
+  CHECK(p0 == p2);
+  CHECK(p1 == p3);
+
+  SECTION("held buffers are never overwritten") {
+    auto held = c1.get_out_port(key).get();
+    step();
+    step();
+    CHECK(c1.get_output(key).data() != held.data());
+    CHECK(c2.get_input(key).data() != held.data());
+  }
+}
+
+TEST_CASE("views pass through ports without copies", "[component]") {
+  auto image = brica2::with<float>({1, 2, 3, 4, 5, 6}, {2, 3});
+
+  brica2::functor_type source = [image](const auto&, auto& outputs) {
+    outputs["row"] = brica2::select(image, 0, 1);
+    outputs["col"] = brica2::select(image, 1, 2);
+  };
+  brica2::functor_type discard = [](const auto&, auto&) {};
+
+  brica2::component c1(source);
+  brica2::component c2(discard);
+
+  c1.make_out_port<float>("row", {3});
+  c1.make_out_port<float>("col", {2});
+  c2.make_in_port<float>("row", {3});
+  c2.make_in_port<float>("col", {2});
+
+  brica2::connect({c1, "row"}, {c2, "row"});
+  brica2::connect({c1, "col"}, {c2, "col"});
+
+  for (int i = 0; i < 2; ++i) {
+    c1.collect();
+    c2.collect();
+    c1.execute();
+    c2.execute();
+    c1.expose();
+    c2.expose();
+  }
+
+  auto base = static_cast<char*>(image.data());
+  CHECK(c2.get_input("row").data() == base + 3 * sizeof(float));
+  CHECK(c2.get_input("col").data() == base + 2 * sizeof(float));
+  CHECK(!c2.get_input("col").is_contiguous());
+  CHECK(brica2::ascontiguous(c2.get_input("col")).as_span<float>()[1] == 6);
+}
+
+TEST_CASE("modified inputs leave the source intact", "[component]") {
+  auto value = brica2::fill({3}, 1.0f);
+
+  brica2::functor_type constant = [value](const auto&, auto& outputs) {
+    outputs["default"] = value;
+  };
+  brica2::functor_type gain = [](const auto& inputs, auto& outputs) {
+    auto& out = outputs["default"] = inputs["default"];
+    for (auto& v : brica2::span<float>(out.template mutable_data<float>(), 3)) {
+      v *= 2.0f;
+    }
+  };
+
+  brica2::component c1(constant);
+  brica2::component c2(gain);
+
+  c1.make_out_port<float>("default", {3});
+  c2.make_in_port<float>("default", {3});
+  c2.make_out_port<float>("default", {3});
+
+  brica2::connect({c1, "default"}, {c2, "default"});
+
+  for (int i = 0; i < 2; ++i) {
+    c1.collect();
+    c2.collect();
+    c1.execute();
+    c2.execute();
+    c1.expose();
+    c2.expose();
+  }
+
+  CHECK(equal(c1.get_out_port("default").get(), value));
+  CHECK(equal(c2.get_output("default"), brica2::fill({3}, 2.0f)));
+  CHECK(c2.get_output("default").data() != value.data());
+}
+
+TEST_CASE("a consumer run twice per step sees the same input", "[component]") {
+  brica2::functor_type source = [](const auto&, auto& outputs) {
+    outputs["default"] = brica2::fill({3}, 1.0f);
+  };
+  brica2::functor_type gain = [](const auto& inputs, auto& outputs) {
+    auto& out = outputs["default"] = inputs["default"];
+    for (auto& v : brica2::span<float>(out.template mutable_data<float>(), 3)) {
+      v *= 2.0f;
+    }
+  };
+
+  brica2::component c1(source);
+  brica2::component c2(gain);
+
+  c1.make_out_port<float>("default", {3});
+  c2.make_in_port<float>("default", {3});
+  c2.make_out_port<float>("default", {3});
+
+  brica2::connect({c1, "default"}, {c2, "default"});
+
+  c1.collect();
+  c1.execute();
+  c1.expose();
+  for (int i = 0; i < 2; ++i) {
+    c2.collect();
+    c2.execute();
+    c2.expose();
+    CHECK(equal(c2.get_output("default"), brica2::fill({3}, 2.0f)));
+  }
+
+  CHECK(equal(c1.get_out_port("default").get(), brica2::fill({3}, 1.0f)));
+  CHECK(equal(c1.get_output("default"), brica2::fill({3}, 1.0f)));
+
+  c2.get_in_port("default") = brica2::port({3}, float());
+  CHECK(equal(c1.get_out_port("default").get(), brica2::fill({3}, 1.0f)));
+}
+
+TEST_CASE("delay lines deliver earlier outputs", "[component]") {
+  int step_count = 0;
+  brica2::functor_type counter = [&](const auto&, auto& outputs) {
+    outputs["t"].template as_span<float>()[0] = float(++step_count);
+  };
+  float seen_now = -1, seen_late = -1;
+  brica2::functor_type observe = [&](const auto& inputs, auto&) {
+    seen_now = inputs.at("now").template as_span<float>()[0];
+    seen_late = inputs.at("late").template as_span<float>()[0];
+  };
+
+  brica2::component c1(counter);
+  brica2::component c2(observe);
+  c1.make_out_port<float>("t", {1});
+  c2.make_in_port<float>("now", {1});
+  c2.make_in_port<float>("late", {1});
+  c1.set_buffering(5);
+
+  brica2::connect({c1, "t"}, {c2, "now"});
+  brica2::connect({c1, "t"}, {c2, "late"}, 3);
+  CHECK(c2.get_in_port("late").get_delay() == 3);
+  CHECK(c2.get_in_port("late") != c1.get_out_port("t"));
+  CHECK(c1.get_out_port("t").history_depth() == 3);
+
+  std::vector<void*> addresses;
+  for (int i = 0; i < 8; ++i) {
+    c1.collect();
+    c2.collect();
+    c1.execute();
+    c2.execute();
+    c1.expose();
+    c2.expose();
+    addresses.push_back(c1.get_output("t").data());
+    // Before step 4, steps before the first read as zeros.
+    CHECK(seen_now == float(i));
+    CHECK(seen_late == float(std::max(0, i - 3)));
+  }
+  // The ring of five slots covers the three held for the delay line.
+  CHECK(addresses[7] == addresses[2]);
+
+  auto window = c1.get_out_port("t").window(3);
+  REQUIRE(window.size() == 3);
+  CHECK(window[0].as_span<float>()[0] == 8);
+  CHECK(window[2].as_span<float>()[0] == 6);
+  CHECK_THROWS_AS(c1.get_out_port("t").history(4), brica2::fail_fast);
+
+  c1.get_out_port("t").keep_history(5);
+  CHECK(c1.get_out_port("t").history(3).as_span<float>()[0] == 5);
+  CHECK(c1.get_out_port("t").history(5).as_span<float>()[0] == 0);
+  CHECK(c2.get_in_port("late").get().as_span<float>()[0] == 5);
+}
+
+TEST_CASE("history of a delay line starts at its delay", "[component]") {
+  brica2::port source({1}, float());
+  auto late = source.delayed(2);
+  late.keep_history(1);
+  CHECK(late.history_depth() == 1);
+  CHECK(source.history_depth() == 3);
+
+  for (int i = 1; i <= 5; ++i) source.set(brica2::fill({1}, float(i)));
+
+  CHECK(late.get().as_span<float>()[0] == 3);
+  CHECK(late.history(0).as_span<float>()[0] == 3);
+  auto window = late.window(2);
+  REQUIRE(window.size() == 2);
+  CHECK(window[0].as_span<float>()[0] == 3);
+  CHECK(window[1].as_span<float>()[0] == 2);
+  CHECK_THROWS_AS(late.history(2), brica2::fail_fast);
+}
+
+TEST_CASE("released outputs are recycled", "[component]") {
+  std::string key = "default";
+  brica2::functor_type ones = [key](const auto&, auto& outputs) {
+    auto span = outputs[key].template as_span<float>();
+    std::fill(span.begin(), span.end(), 1.0f);
+  };
+  brica2::functor_type discard = [](const auto&, auto&) {};
+
+  brica2::component c1(ones);
+  brica2::component c2(discard);
+  c1.make_out_port<float>(key, {3});
+  c2.make_in_port<float>(key, {3});
+  brica2::connect({c1, key}, {c2, key});
+
+  auto step = [&]() {
+    c1.collect();
+    c2.collect();
+    c1.execute();
+    c2.execute();
+    c1.expose();
+    c2.expose();
+  };
+
+  std::vector<void*> addresses;
+  for (int i = 0; i < 6; ++i) {
+    step();
+    addresses.push_back(c1.get_output(key).data());
+  }
+  // Once the consumer lets go of last step's output, it is written again.
+  CHECK(addresses[2] == addresses[4]);
+  CHECK(addresses[3] == addresses[5]);
+  CHECK(addresses[4] != addresses[5]);
+
+  SECTION("held buffers are not recycled") {
+    auto held = c1.get_out_port(key).get();
+    for (int i = 0; i < 3; ++i) {
+      step();
+      CHECK(c1.get_output(key).data() != held.data());
+    }
+  }
+
+  SECTION("buffers the functor keeps are not recycled") {
+    auto value = brica2::fill({3}, 2.0f);
+    brica2::component c3([&](const auto&, auto& outputs) {
+      outputs[key] = value;
+    });
+    c3.make_out_port<float>(key, {3});
+    for (int i = 0; i < 3; ++i) {
+      c3.collect();
+      c3.execute();
+      c3.expose();
+      CHECK(value.as_span<float>()[0] == 2.0f);
+      CHECK(c3.get_output(key) == value);
+    }
+  }
+}
+
+TEST_CASE("functors index ports through handles", "[component]") {
+  brica2::in_port_handle x, y;
+  brica2::out_port_handle sum;
+  brica2::component c1([&](const auto& inputs, auto& outputs) {
+    auto a = inputs[x].template as_span<float>();
+    auto b = inputs[y].template as_span<float>();
+    auto out = outputs[sum].template as_span<float>();
+    for (brica2::ssize_t i = 0; i < out.size(); ++i) out[i] = a[i] + b[i];
+  });
+  c1.make_in_port<float>("y", {2});
+  c1.make_in_port<float>("x", {2});
+  c1.make_out_port<float>("sum", {2});
+  x = c1.in_handle("x");
+  y = c1.in_handle("y");
+  sum = c1.out_handle("sum");
+  CHECK(x.index == 0);
+  CHECK(y.index == 1);
+  CHECK_THROWS_AS(c1.in_handle("z"), std::out_of_range);
+  CHECK(c1.get_in_port(x) == c1.get_in_port("x"));
+
+  c1.get_in_port(x).set(brica2::with<float>({1, 2}, {2}));
+  c1.get_in_port(y).set(brica2::with<float>({10, 20}, {2}));
+  c1.collect();
+  c1.execute();
+  c1.expose();
+  CHECK(c1.get_output("sum").as_span<float>()[1] == 22);
+
+  CHECK_FALSE(
+      (std::is_convertible<brica2::in_port_handle,
+                           brica2::out_port_handle>::value));
+  c1.make_in_port<float>("w", {2});
+  CHECK_THROWS_AS(c1.get_in_port(x), brica2::fail_fast);
+  c1.collect();
+  CHECK_THROWS_AS(c1.execute(), brica2::fail_fast);
+  CHECK(c1.get_out_port(sum) == c1.get_out_port("sum"));
+}
+
+TEST_CASE("port lookup cost", "[.][benchmark]") {
+  brica2::input_dictionary d;
+  for (int i = 0; i < 16; ++i) {
+    d["port" + std::to_string(i)] = brica2::fill({1}, 1.0f);
+  }
+  const std::string key = "port11";
+  const brica2::in_port_handle h{11, 16};
+  const std::size_t n = 1 << 20;
+  std::size_t total = 0;
+  BENCHMARK("string keys") {
+    for (std::size_t i = 0; i < n; ++i) total += d[key].size();
+  }
+  BENCHMARK("handles") {
+    for (std::size_t i = 0; i < n; ++i) total += d[h].size();
+  }
+  CHECK(total > 0);
+}
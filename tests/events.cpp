@@ -0,0 +1,137 @@
+#include "catch.hpp"
+#include "brica2/component.hpp"
+#include "brica2/events.hpp"
+
+#include <string>
+#include <vector>
+
+TEST_CASE("event buffers", "[events]") {
+  SECTION("construction and layout") {
+    auto e = brica2::make_events(100000, 1000);
+    auto& info = e.request();
+    CHECK(info.events.sparse());
+    CHECK(info.events.extent == 100000);
+    CHECK(info.shape == brica2::extents({1000}));
+    CHECK(e.size_bytes() == 4000);
+    CHECK(brica2::event_count(e) == 0);
+    CHECK(brica2::make_events(16).size() == 16);
+    CHECK(brica2::make_events<float>(16, 4).request().shape ==
+          brica2::extents({2, 4}));
+    CHECK_FALSE(brica2::fill({4}, 0.0f).request().events.sparse());
+  }
+
+  SECTION("compatibility") {
+    auto a = brica2::make_events(64, 8);
+    CHECK(brica2::compatible(a, brica2::make_events(64, 8)));
+    CHECK_FALSE(brica2::compatible(a, brica2::make_events(65, 8)));
+    CHECK_FALSE(brica2::compatible(a, brica2::make_events<float>(64, 8)));
+    CHECK_FALSE(brica2::compatible(a, brica2::empty<std::uint32_t>({8})));
+    brica2::add_event(a, 3);
+    CHECK(brica2::compatible(a, brica2::make_events(64, 8)));
+  }
+
+  SECTION("adding events") {
+    auto e = brica2::make_events(10, 2);
+    brica2::add_event(e, 7);
+    brica2::add_event(e, 2);
+    CHECK(brica2::event_count(e) == 2);
+    CHECK(brica2::event_addresses(e)[0] == 7);
+    CHECK(brica2::event_addresses(e)[1] == 2);
+    CHECK_THROWS_AS(brica2::add_event(e, 1), brica2::fail_fast);
+    brica2::clear_events(e);
+    CHECK(brica2::event_count(e) == 0);
+    CHECK_THROWS_AS(brica2::add_event(e, 10), brica2::fail_fast);
+    CHECK_THROWS_AS(brica2::add_event(e, 1, 0.5f), brica2::fail_fast);
+
+    auto p = brica2::make_events<float>(10, 2);
+    brica2::add_event(p, 4, 0.25f);
+    CHECK(brica2::event_payload<float>(p)[0] == 0.25f);
+    CHECK_THROWS_AS(brica2::event_payload<int>(p), brica2::fail_fast);
+  }
+
+  SECTION("dense conversions") {
+    auto dense = brica2::with<float>({0, 2, 0, 0, -1, 0}, {2, 3});
+    auto e = brica2::to_events(dense);
+    CHECK(e.request().events.extent == 6);
+    REQUIRE(brica2::event_count(e) == 2);
+    CHECK(brica2::event_addresses(e)[0] == 1);
+    CHECK(brica2::event_addresses(e)[1] == 4);
+    auto back = brica2::to_dense(e);
+    CHECK(back.request().shape == brica2::extents({6}));
+    CHECK(std::vector<float>(
+              back.as_span<float>().begin(), back.as_span<float>().end()) ==
+          std::vector<float>({0, 1, 0, 0, 1, 0}));
+
+    auto valued = brica2::to_dense(brica2::to_events<float>(dense));
+    CHECK(valued.as_span<float>()[1] == 2);
+    CHECK(valued.as_span<float>()[4] == -1);
+    CHECK_THROWS_AS(brica2::to_events(dense, 1), brica2::fail_fast);
+    CHECK_THROWS_AS(brica2::to_events<int>(dense), brica2::fail_fast);
+  }
+
+  SECTION("copies keep the events, fresh buffers have none") {
+    auto e = brica2::make_events<int>(10, 4);
+    brica2::add_event(e, 1, 5);
+    brica2::add_event(e, 8, 6);
+    auto c = brica2::copy(e);
+    CHECK(brica2::event_count(c) == 2);
+    CHECK(brica2::event_payload<int>(c)[1] == 6);
+    CHECK(brica2::event_count(brica2::empty_like(e)) == 0);
+  }
+
+  SECTION("wire format") {
+    auto e = brica2::make_events<float>(100, 50);
+    brica2::add_event(e, 9, 1.5f);
+    brica2::add_event(e, 3, 2.5f);
+    std::vector<brica2::event_address> words(
+        brica2::detail::max_event_words(e.request()));
+    CHECK(words.size() == 101);
+    CHECK(brica2::detail::pack_events(e, words.data()) == 5);
+    auto r = brica2::make_events<float>(100, 50);
+    brica2::detail::unpack_events(words.data(), r);
+    REQUIRE(brica2::event_count(r) == 2);
+    CHECK(brica2::event_addresses(r)[1] == 3);
+    CHECK(brica2::event_payload<float>(r)[0] == 1.5f);
+  }
+}
+
+TEST_CASE("event ports", "[events][component]") {
+  const brica2::event_address period = 3;
+  int step_count = 0;
+  brica2::functor_type spike = [&](const auto&, auto& outputs) {
+    auto& e = outputs["spikes"];
+    for (brica2::event_address i = step_count % period; i < 1000; i += period) {
+      brica2::add_event(e, i);
+    }
+    ++step_count;
+  };
+  std::size_t received = 0;
+  brica2::functor_type count = [&](const auto& inputs, auto&) {
+    received = brica2::event_count(inputs.at("spikes"));
+  };
+
+  brica2::component c1(spike);
+  brica2::component c2(count);
+  brica2::component dense(count);
+  c1.make_out_port("spikes", brica2::make_events(1000, 400));
+  c2.make_in_port("spikes", brica2::make_events(1000, 400));
+  dense.make_in_port<std::uint32_t>("spikes", {400});
+  c1.set_buffering(2);
+
+  CHECK_THROWS_AS(
+      brica2::connect({c1, "spikes"}, {dense, "spikes"}),
+      brica2::incompatible_exception);
+  brica2::connect({c1, "spikes"}, {c2, "spikes"});
+
+  for (int i = 0; i < 4; ++i) {
+    c1.collect();
+    c2.collect();
+    c1.execute();
+    c2.execute();
+    c1.expose();
+    c2.expose();
+  }
+  // Reused ring slots start out empty: every step emits 333 or 334 events.
+  CHECK(brica2::event_count(c1.get_output("spikes")) == 334);
+  CHECK(received == 333);
+}
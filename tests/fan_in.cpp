@@ -0,0 +1,185 @@
+#include "catch.hpp"
+#include "brica2/brica2.hpp"
+#include "brica2/events.hpp"
+#include "brica2/fan_in.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+
+brica2::buffer from(const std::vector<float>& v) {
+  auto ret = brica2::empty<float>({brica2::ssize_t(v.size())});
+  std::copy(v.begin(), v.end(), ret.as_span<float>().begin());
+  return ret;
+}
+
+// A sink whose "x" port merges every source under `op`.
+brica2::component make_sink(
+    brica2::fan_in_op op,
+    std::vector<float>& seen,
+    brica2::executor_type* executor = nullptr) {
+  brica2::component sink([&seen](const auto& inputs, auto&) {
+    auto s = inputs["x"].template as_span<float>();
+    seen.assign(s.begin(), s.end());
+  });
+  sink.make_in_port<float>("x", {4});
+  brica2::make_fan_in(sink.get_in_port("x"), op, executor, 4);
+  return sink;
+}
+
+std::vector<float> reduce(
+    brica2::fan_in_op op,
+    const std::vector<std::vector<float>>& values,
+    brica2::executor_type* executor = nullptr) {
+  std::vector<float> seen;
+  auto sink = make_sink(op, seen, executor);
+  std::vector<brica2::port> sources;
+  for (auto& v : values) {
+    sources.emplace_back(from(v));
+    brica2::connect(sources.back(), sink.get_in_port("x"));
+  }
+  sink.collect();
+  sink.execute();
+  return seen;
+}
+
+}  // namespace
+
+TEST_CASE("fan-in ports", "[fan_in]") {
+  using op = brica2::fan_in_op;
+  std::vector<std::vector<float>> values = {
+      {1, 0, 3, -1}, {2, 0, -5, 4}, {0, 0, 1, 2}};
+
+  SECTION("reductions") {
+    CHECK(reduce(op::sum, values) == std::vector<float>({3, 0, -1, 5}));
+    CHECK(reduce(op::max, values) == std::vector<float>({2, 0, 3, 4}));
+    CHECK(reduce(op::logical_or, values) == std::vector<float>({1, 0, 1, 1}));
+    CHECK(reduce(op::sum, {values[1]}) == values[1]);
+  }
+
+  SECTION("a port without sources keeps its content") {
+    std::vector<float> seen;
+    auto sink = make_sink(op::sum, seen);
+    sink.collect();
+    sink.execute();
+    CHECK(seen == std::vector<float>(4, 0));
+  }
+
+  SECTION("generations follow the sources") {
+    brica2::port target({4}, float());
+    brica2::make_fan_in(target, op::sum);
+    brica2::port a({4}, float()), b({4}, float());
+    brica2::connect(a, target);
+    brica2::connect(b, target);
+    auto g = target.generation();
+    target.merge();
+    CHECK(target.generation() == g);
+    b.set(brica2::fill<float>({4}, 1));
+    CHECK(target.generation() != g);
+  }
+
+  SECTION("sources are still checked") {
+    std::vector<float> seen;
+    auto sink = make_sink(op::sum, seen);
+    brica2::port wrong({5}, float());
+    CHECK_THROWS_AS(
+        brica2::connect(wrong, sink.get_in_port("x")),
+        brica2::incompatible_exception);
+  }
+
+  SECTION("the sliced reduction matches the sequential one") {
+    std::vector<std::vector<float>> many;
+    for (int i = 0; i < 13; ++i) {
+      many.push_back({float(i), float(i % 3), -float(i), 1});
+    }
+    brica2::parallel exec(4);
+    for (auto o : {op::sum, op::max, op::logical_or}) {
+      CHECK(reduce(o, many, &exec) == reduce(o, many));
+    }
+    CHECK(
+        reduce(op::sum, many, &exec) ==
+        std::vector<float>({78, 12, -78, 13}));
+
+    // Long enough to split into slices where there are threads for them.
+    const brica2::ssize_t size = 3 * 4096 + 5;
+    brica2::port wide({size}, float());
+    brica2::make_fan_in(wide, op::sum, &exec, 4);
+    std::vector<brica2::port> sources;
+    for (int i = 0; i < 8; ++i) {
+      sources.emplace_back(brica2::fill({size}, float(i)));
+      brica2::connect(sources.back(), wide);
+    }
+    wide.merge();
+    auto s = wide.get().as_span<float>();
+    CHECK(std::all_of(s.begin(), s.end(), [](float v) { return v == 28; }));
+  }
+
+  SECTION("upstream components fan in through the scheduler") {
+    std::vector<brica2::component> sources;
+    for (int i = 0; i < 3; ++i) {
+      auto v = from(values[i]);
+      sources.emplace_back([v](const auto&, auto& outputs) {
+        outputs["y"] = v;
+      });
+      sources.back().make_out_port<float>("y", {4});
+    }
+    std::vector<float> seen;
+    auto sink = make_sink(op::sum, seen);
+    brica2::serial exec;
+    brica2::single_phase_scheduler s(exec);
+    for (auto& c : sources) {
+      brica2::connect({c, "y"}, {sink, "x"});
+      s.add(c);
+    }
+    s.add(sink);
+    for (int i = 0; i < 3; ++i) s.step();
+    CHECK(seen == std::vector<float>({3, 0, -1, 5}));
+  }
+
+  SECTION("event buffers merge as a union") {
+    auto a = brica2::make_events<float>(8, 4);
+    auto b = brica2::make_events<float>(8, 4);
+    brica2::add_event(a, 1, 0.5f);
+    brica2::add_event(a, 6, 1.5f);
+    brica2::add_event(b, 6, 9.0f);
+    brica2::add_event(b, 2, 2.5f);
+    brica2::port target(brica2::make_events<float>(8, 4));
+    brica2::make_fan_in(target, op::logical_or);
+    brica2::port pa(a), pb(b);
+    brica2::connect(pa, target);
+    brica2::connect(pb, target);
+    target.merge();
+    auto dense = brica2::to_dense(target.get());
+    CHECK(dense.as_span<float>()[1] == 0.5f);
+    CHECK(dense.as_span<float>()[6] == 1.5f);
+    CHECK(dense.as_span<float>()[2] == 2.5f);
+    CHECK(brica2::event_count(target.get()) == 3);
+
+    brica2::port summed(brica2::make_events<float>(8, 4));
+    CHECK_THROWS_AS(
+        brica2::make_fan_in(summed, op::sum), brica2::fail_fast);
+    CHECK_THROWS_AS(
+        brica2::make_fan_in(summed, op::max), brica2::fail_fast);
+  }
+}
+
+TEST_CASE("fan-in reduction cost", "[.][benchmark]") {
+  const int sources = 64;
+  const brica2::ssize_t size = 1 << 16;
+  std::vector<brica2::port> ports;
+  for (int i = 0; i < sources; ++i) {
+    ports.emplace_back(brica2::fill({size}, float(i)));
+  }
+  brica2::parallel exec(4);
+  for (auto executor : {(brica2::executor_type*)nullptr,
+                        (brica2::executor_type*)&exec}) {
+    brica2::port target({size}, float());
+    brica2::make_fan_in(target, brica2::fan_in_op::sum, executor);
+    for (auto& p : ports) brica2::connect(p, target);
+    BENCHMARK(std::string(executor ? "sliced" : "linear")) {
+      for (int i = 0; i < 20; ++i) target.merge();
+    }
+  }
+}
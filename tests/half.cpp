@@ -0,0 +1,174 @@
+#include "catch.hpp"
+#include "brica2/convert.hpp"
+#include "brica2/view.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+template <class F> void for_each_isa(F f) {
+  using brica2::simd::isa;
+  auto saved = brica2::simd::active_isa();
+  for (auto target : {isa::scalar, isa::sse2, isa::avx2, isa::avx512}) {
+    if (target > brica2::simd::detected_isa()) break;
+    brica2::simd::set_isa(target);
+    f(target);
+  }
+  brica2::simd::set_isa(saved);
+}
+
+std::uint16_t bits(brica2::float16 h) { return h.bits; }
+std::uint16_t bits(brica2::bfloat16 b) { return b.bits; }
+
+std::uint32_t bits(float f) { return brica2::detail::float_bits(f); }
+
+// Every 16-bit pattern, so widening can be checked exhaustively.
+template <class T> brica2::buffer all_patterns() {
+  auto b = brica2::empty<T>({65536});
+  auto s = b.template as_span<T>();
+  for (std::uint32_t i = 0; i < 65536; ++i) s[i] = T::from_bits(i);
+  return b;
+}
+
+// Special values, boundaries and random floats for narrowing.
+brica2::buffer narrowing_cases() {
+  std::vector<float> v = {0.0f, -0.0f, 1.0f, -1.0f, 65504.0f, 65519.0f,
+                          65520.0f, 1e30f, -1e30f, 6.1e-5f, 5.96e-8f,
+                          2.9e-8f, 1e-40f, -1e-40f, 3.0e38f};
+  v.push_back(std::numeric_limits<float>::infinity());
+  v.push_back(-std::numeric_limits<float>::infinity());
+  v.push_back(std::numeric_limits<float>::quiet_NaN());
+  v.push_back(brica2::detail::bits_float(0x7f800001));  // signaling
+  v.push_back(brica2::detail::bits_float(0xffc12345));
+  v.push_back(std::numeric_limits<float>::denorm_min());
+  v.push_back(std::numeric_limits<float>::min());
+  v.push_back(std::numeric_limits<float>::max());
+  // Ties between neighbouring 16-bit values, both ways.
+  v.push_back(brica2::detail::bits_float(0x3f801000));
+  v.push_back(brica2::detail::bits_float(0x3f803000));
+  v.push_back(brica2::detail::bits_float(0x3f808000));
+  v.push_back(brica2::detail::bits_float(0x3f818000));
+  std::mt19937 engine(3);
+  std::uniform_int_distribution<std::uint32_t> dist;
+  while (v.size() < 1000 + 7) {
+    v.push_back(brica2::detail::bits_float(dist(engine)));
+  }
+  auto b = brica2::empty<float>({brica2::ssize_t(v.size())});
+  std::copy(v.begin(), v.end(), b.as_span<float>().begin());
+  return b;
+}
+
+}  // namespace
+
+TEST_CASE("16-bit floating point types", "[half]") {
+  using brica2::bfloat16;
+  using brica2::float16;
+
+  SECTION("format codes") {
+    CHECK(brica2::FormatDescriptor<float16>::code() == 'e');
+    CHECK(brica2::FormatDescriptor<bfloat16>::code() == 'E');
+    auto b = brica2::empty<float16>({4});
+    CHECK(b.request().itemsize == 2);
+    CHECK(b.request().format == "e");
+  }
+
+  SECTION("float16 rounding") {
+    CHECK(bits(float16(1.0f)) == 0x3c00);
+    CHECK(bits(float16(-2.0f)) == 0xc000);
+    CHECK(bits(float16(65504.0f)) == 0x7bff);
+    CHECK(bits(float16(65519.0f)) == 0x7bff);
+    CHECK(bits(float16(65520.0f)) == 0x7c00);
+    CHECK(bits(float16(std::ldexp(1.0f, -24))) == 0x0001);
+    CHECK(bits(float16(std::ldexp(1.0f, -25))) == 0x0000);
+    CHECK(bits(float16(std::ldexp(3.0f, -25))) == 0x0002);
+    CHECK(bits(float16(1.0f + std::ldexp(1.0f, -11))) == 0x3c00);
+    CHECK(bits(float16(1.0f + std::ldexp(3.0f, -11))) == 0x3c02);
+    CHECK(std::isnan(float(float16(std::nanf("")))));
+    for (std::uint32_t i = 0; i < 65536; ++i) {
+      auto h = float16::from_bits(i);
+      if (std::isnan(float(h))) continue;
+      if (bits(float16(float(h))) != i) FAIL("round trip of " << i);
+    }
+  }
+
+  SECTION("bfloat16 rounding") {
+    CHECK(bits(bfloat16(1.0f)) == 0x3f80);
+    CHECK(bits(bfloat16(brica2::detail::bits_float(0x3f808000))) == 0x3f80);
+    CHECK(bits(bfloat16(brica2::detail::bits_float(0x3f818000))) == 0x3f82);
+    CHECK(bits(bfloat16(brica2::detail::bits_float(0x3f808001))) == 0x3f81);
+    CHECK(bits(bfloat16(1e-40f)) == 0x0000);
+    CHECK(bits(bfloat16(-1e-40f)) == 0x8000);
+    CHECK(float(bfloat16::from_bits(0x4049)) == 3.140625f);
+  }
+
+  SECTION("vector conversions match the scalar ones") {
+    auto halves = all_patterns<float16>();
+    auto bfloats = all_patterns<bfloat16>();
+    auto floats = narrowing_cases();
+    for_each_isa([&](brica2::simd::isa target) {
+      INFO(brica2::simd::isa_name(target));
+      auto wide_halves = brica2::astype<float>(halves);
+      auto wide_bfloats = brica2::astype<float>(bfloats);
+      auto narrow_halves = brica2::astype<float16>(floats);
+      auto narrow_bfloats = brica2::astype<bfloat16>(floats);
+      CHECK(wide_halves.request().format == 'f');
+      CHECK(narrow_bfloats.request().format == 'E');
+
+      auto h = halves.as_span<float16>();
+      auto b = bfloats.as_span<bfloat16>();
+      auto wh = wide_halves.as_span<float>();
+      auto wb = wide_bfloats.as_span<float>();
+      std::size_t mismatches = 0;
+      for (std::size_t i = 0; i < 65536; ++i) {
+        if (bits(wh[i]) != bits(float(h[i]))) ++mismatches;
+        if (bits(wb[i]) != bits(float(b[i]))) ++mismatches;
+      }
+      CHECK(mismatches == 0);
+
+      auto f = floats.as_span<float>();
+      auto nh = narrow_halves.as_span<float16>();
+      auto nb = narrow_bfloats.as_span<bfloat16>();
+      for (std::size_t i = 0; i < floats.size(); ++i) {
+        INFO("input " << std::hex << bits(f[i]));
+        CHECK(bits(nh[i]) == bits(float16(f[i])));
+        CHECK(bits(nb[i]) == bits(bfloat16(f[i])));
+      }
+    });
+  }
+
+  SECTION("strided sources and mismatches") {
+    auto m = brica2::with<float>({1, 2, 3, 4, 5, 6}, {2, 3});
+    auto column = brica2::astype<float16>(brica2::select(m, 1, 1));
+    CHECK(float(column.as_span<float16>()[0]) == 2.0f);
+    CHECK(float(column.as_span<float16>()[1]) == 5.0f);
+
+    auto out = brica2::empty<bfloat16>({3});
+    CHECK_THROWS_AS(brica2::convert(m, out), brica2::incompatible_exception);
+    auto ints = brica2::empty<int>({2, 3});
+    CHECK_THROWS_AS(brica2::convert(m, ints), brica2::fail_fast);
+  }
+}
+
+TEST_CASE("16-bit conversion throughput", "[.][benchmark]") {
+  const std::size_t n = 1 << 20;
+  auto wide = brica2::fill({brica2::ssize_t(n)}, 1.5f);
+  auto halves = brica2::empty<brica2::float16>({brica2::ssize_t(n)});
+  auto bfloats = brica2::empty<brica2::bfloat16>({brica2::ssize_t(n)});
+
+  for_each_isa([&](brica2::simd::isa target) {
+    std::string suffix = std::string(", ") + brica2::simd::isa_name(target);
+    BENCHMARK("float to float16" + suffix) { brica2::convert(wide, halves); }
+    BENCHMARK("float16 to float" + suffix) { brica2::convert(halves, wide); }
+    BENCHMARK("float to bfloat16" + suffix) {
+      brica2::convert(wide, bfloats);
+    }
+    BENCHMARK("bfloat16 to float" + suffix) {
+      brica2::convert(bfloats, wide);
+    }
+  });
+}
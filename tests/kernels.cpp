@@ -0,0 +1,179 @@
+#include "catch.hpp"
+#include "brica2/kernels.hpp"
+#include "brica2/view.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+template <class T> brica2::buffer random_buffer(std::size_t n, T lo, T hi) {
+  static std::mt19937 engine(42);
+  std::uniform_real_distribution<T> dist(lo, hi);
+  auto b = brica2::empty<T>({brica2::ssize_t(n)});
+  for (auto& v : b.template as_span<T>()) v = dist(engine);
+  return b;
+}
+
+// Runs `f` once for every instruction set the CPU supports.
+template <class F> void for_each_isa(F f) {
+  using brica2::simd::isa;
+  auto saved = brica2::simd::active_isa();
+  for (auto target : {isa::scalar, isa::sse2, isa::avx2, isa::avx512}) {
+    if (target > brica2::simd::detected_isa()) break;
+    brica2::simd::set_isa(target);
+    f(target);
+  }
+  brica2::simd::set_isa(saved);
+}
+
+template <class T> void check_elementwise(T tolerance) {
+  const std::size_t n = 37;
+  auto a = random_buffer<T>(n, -10, 10);
+  auto b = random_buffer<T>(n, -10, 10);
+  auto c = random_buffer<T>(n, -10, 10);
+  auto x = a.template as_span<T>();
+  auto y = b.template as_span<T>();
+  auto z = c.template as_span<T>();
+
+  for_each_isa([&](brica2::simd::isa target) {
+    INFO(brica2::simd::isa_name(target));
+    auto results = {brica2::add(a, b),      brica2::mul(a, b),
+                    brica2::fma(a, b, c),   brica2::clamp(a, -1, 2),
+                    brica2::relu(a),        brica2::sigmoid(a),
+                    brica2::maximum(a, b)};
+    auto r = results.begin();
+    auto sum = r[0].template as_span<T>();
+    auto product = r[1].template as_span<T>();
+    auto fused = r[2].template as_span<T>();
+    auto clamped = r[3].template as_span<T>();
+    auto rectified = r[4].template as_span<T>();
+    auto squashed = r[5].template as_span<T>();
+    auto larger = r[6].template as_span<T>();
+    for (std::size_t i = 0; i < n; ++i) {
+      CHECK(sum[i] == x[i] + y[i]);
+      CHECK(product[i] == x[i] * y[i]);
+      CHECK(std::abs(fused[i] - (x[i] * y[i] + z[i])) <= tolerance * 100);
+      CHECK(clamped[i] == std::min(std::max(x[i], T(-1)), T(2)));
+      CHECK(rectified[i] == std::max(x[i], T(0)));
+      CHECK(larger[i] == std::max(x[i], y[i]));
+      auto expected = 1 / (1 + std::exp(-x[i]));
+      CHECK(std::abs(squashed[i] - expected) <= tolerance * expected);
+    }
+  });
+}
+
+template <class T> void check_integer_elementwise() {
+  static std::mt19937 engine(7);
+  std::uniform_int_distribution<int> dist(-100, 100);
+  const std::size_t n = 37;
+  std::vector<brica2::buffer> operands;
+  for (int k = 0; k < 3; ++k) {
+    operands.push_back(brica2::empty<T>({brica2::ssize_t(n)}));
+    for (auto& v : operands.back().template as_span<T>()) v = T(dist(engine));
+  }
+  auto &a = operands[0], &b = operands[1], &c = operands[2];
+  auto x = a.template as_span<T>();
+  auto y = b.template as_span<T>();
+  auto z = c.template as_span<T>();
+
+  for_each_isa([&](brica2::simd::isa target) {
+    INFO(brica2::simd::isa_name(target));
+    auto results = {brica2::add(a, b),      brica2::mul(a, b),
+                    brica2::fma(a, b, c),   brica2::clamp(a, -10, 20),
+                    brica2::relu(a),        brica2::maximum(a, b)};
+    auto r = results.begin();
+    auto sum = r[0].template as_span<T>();
+    auto product = r[1].template as_span<T>();
+    auto fused = r[2].template as_span<T>();
+    auto clamped = r[3].template as_span<T>();
+    auto rectified = r[4].template as_span<T>();
+    auto larger = r[5].template as_span<T>();
+    for (std::size_t i = 0; i < n; ++i) {
+      CHECK(sum[i] == T(x[i] + y[i]));
+      CHECK(product[i] == T(x[i] * y[i]));
+      CHECK(fused[i] == T(x[i] * y[i] + z[i]));
+      CHECK(clamped[i] == std::min(std::max(x[i], T(-10)), T(20)));
+      CHECK(rectified[i] == std::max(x[i], T(0)));
+      CHECK(larger[i] == std::max(x[i], y[i]));
+    }
+    CHECK_THROWS_AS(brica2::sigmoid(a), brica2::fail_fast);
+  });
+}
+
+}  // namespace
+
+TEST_CASE("elementwise kernels", "[kernels]") {
+  SECTION("float") { check_elementwise<float>(1e-6f); }
+  SECTION("double") { check_elementwise<double>(1e-14); }
+
+  SECTION("sigmoid saturates") {
+    auto a = brica2::with<float>({-1000, -80, 0, 80, 1000}, {5});
+    for_each_isa([&](brica2::simd::isa) {
+      auto out = brica2::sigmoid(a);
+      auto s = out.as_span<float>();
+      CHECK(s[0] >= 0.0f);
+      CHECK(s[0] < 1e-30f);
+      CHECK(s[1] < 1e-30f);
+      CHECK(s[2] == 0.5f);
+      CHECK(s[3] == 1.0f);
+      CHECK(s[4] == 1.0f);
+    });
+  }
+
+  SECTION("int32") { check_integer_elementwise<std::int32_t>(); }
+  SECTION("int16") { check_integer_elementwise<std::int16_t>(); }
+
+  SECTION("other integers use the scalar kernels") {
+    auto a = brica2::with<long>({-3, 1, 4, -1, 5}, {5});
+    auto out = brica2::relu(brica2::add(a, a));
+    auto r = out.as_span<long>();
+    CHECK(std::vector<long>(r.begin(), r.end()) ==
+          std::vector<long>({0, 2, 8, 0, 10}));
+    CHECK_THROWS_AS(brica2::sigmoid(a), brica2::fail_fast);
+  }
+
+  SECTION("strided operands and in-place output") {
+    auto m = brica2::with<float>({1, 2, 3, 4, 5, 6}, {2, 3});
+    auto column = brica2::select(m, 1, 1);
+    auto out = brica2::fill({2}, 10.0f);
+    auto data = out.data();
+    brica2::add(out, column, out);
+    CHECK(out.data() == data);
+    CHECK(out.as_span<float>()[0] == 12.0f);
+    CHECK(out.as_span<float>()[1] == 15.0f);
+
+    auto shared = out;
+    brica2::relu(column, out);
+    CHECK(out.data() != data);
+    CHECK(shared.as_span<float>()[0] == 12.0f);
+  }
+
+  SECTION("operands must match") {
+    using brica2::incompatible_exception;
+    auto a = brica2::fill({3}, 1.0f);
+    CHECK_THROWS_AS(brica2::add(a, brica2::fill({4}, 1.0f)),
+                    incompatible_exception);
+    CHECK_THROWS_AS(brica2::add(a, brica2::fill({3}, 1.0)),
+                    incompatible_exception);
+  }
+}
+
+TEST_CASE("elementwise kernel throughput", "[.][benchmark]") {
+  const std::size_t n = 1 << 20;
+  auto a = random_buffer<float>(n, -4, 4);
+  auto b = random_buffer<float>(n, -4, 4);
+  auto c = random_buffer<float>(n, -4, 4);
+  auto out = brica2::empty_like(a);
+
+  for_each_isa([&](brica2::simd::isa target) {
+    std::string suffix = std::string(", ") + brica2::simd::isa_name(target);
+    BENCHMARK("add" + suffix) { brica2::add(a, b, out); }
+    BENCHMARK("fma" + suffix) { brica2::fma(a, b, c, out); }
+    BENCHMARK("relu" + suffix) { brica2::relu(a, out); }
+    BENCHMARK("sigmoid" + suffix) { brica2::sigmoid(a, out); }
+  });
+}
@@ -0,0 +1,88 @@
+#include "catch.hpp"
+#include "brica2/mapped.hpp"
+#include "brica2/view.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <system_error>
+
+#include <unistd.h>
+
+namespace {
+
+struct temporary_file {
+  temporary_file() {
+    char name[] = "/tmp/brica2-mapped-XXXXXX";
+    int fd = ::mkstemp(name);
+    REQUIRE(fd >= 0);
+    ::close(fd);
+    path = name;
+  }
+  ~temporary_file() { std::remove(path.c_str()); }
+  std::string path;
+};
+
+}  // namespace
+
+TEST_CASE("file-backed buffers", "[mapped]") {
+  temporary_file file;
+  auto b = brica2::with<float>({0, 1, 2, 3, 4, 5}, {2, 3});
+  brica2::save_mapped(b, file.path);
+
+  SECTION("read only") {
+    auto m = brica2::map_file(file.path);
+    REQUIRE(brica2::compatible(m, b));
+    REQUIRE(m.is_contiguous());
+    REQUIRE(m.read_only());
+    REQUIRE(m.alignment() >= 4096);
+    auto span = m.as_span<float>();
+    REQUIRE(span[4] == 4.0f);
+
+    auto v = brica2::select(m, 0, 1);
+    REQUIRE(v.read_only());
+    REQUIRE(v.as_span<float>()[0] == 3.0f);
+
+    auto p = m.mutable_data<float>();
+    p[0] = 10.0f;
+    REQUIRE_FALSE(m.read_only());
+    REQUIRE(v.as_span<float>()[0] == 3.0f);
+    REQUIRE(brica2::map_file(file.path).as_span<float>()[0] == 0.0f);
+  }
+
+  SECTION("copy on write") {
+    auto m = brica2::map_file(file.path, brica2::map_mode::copy_on_write);
+    REQUIRE_FALSE(m.read_only());
+    REQUIRE(m.unique());
+    auto data = m.data();
+    m.mutable_data<float>()[0] = 10.0f;
+    REQUIRE(m.data() == data);
+    REQUIRE(brica2::map_file(file.path).as_span<float>()[0] == 0.0f);
+  }
+
+  SECTION("strided buffers are saved packed") {
+    brica2::save_mapped(brica2::transpose(b), file.path);
+    auto m = brica2::map_file(file.path);
+    REQUIRE(m.request().shape == brica2::extents({3, 2}));
+    REQUIRE(m.as_span<float>()[1] == 3.0f);
+  }
+
+  SECTION("quantization parameters") {
+    auto q = brica2::with<signed char>({-3, 0, 7}, {3});
+    q.request().quant = brica2::quantization{0.25f, -2};
+    brica2::save_mapped(q, file.path);
+    auto m = brica2::map_file(file.path);
+    REQUIRE(m.request().quant == q.request().quant);
+    REQUIRE(m.as_span<signed char>()[2] == 7);
+  }
+
+  SECTION("errors") {
+    REQUIRE_THROWS_AS(
+        brica2::map_file(file.path + ".missing"), std::system_error);
+    std::FILE* f = std::fopen(file.path.c_str(), "w");
+    std::fputs("not a buffer", f);
+    std::fclose(f);
+    REQUIRE_THROWS_AS(
+        brica2::map_file(file.path), brica2::mapped_format_exception);
+  }
+}
@@ -0,0 +1,82 @@
+#include "catch.hpp"
+#include "brica2/mdspan.hpp"
+#include "brica2/view.hpp"
+
+#include <numeric>
+
+TEST_CASE("mdspan indexing", "[mdspan]") {
+  auto b = brica2::empty<float>({3, 4});
+  auto flat = b.as_span<float>();
+  std::iota(flat.begin(), flat.end(), 0.0f);
+
+  SECTION("dynamic extents") {
+    auto m = brica2::as_dynamic_mdspan<float, 2>(b);
+    REQUIRE(m.rank() == 2);
+    REQUIRE(m.extent(0) == 3);
+    REQUIRE(m.extent(1) == 4);
+    REQUIRE(m.size() == 12);
+    REQUIRE(m.is_contiguous());
+    REQUIRE(m(0, 0) == 0.0f);
+    REQUIRE(m(2, 1) == 9.0f);
+    m(1, 3) = 42.0f;
+    REQUIRE(flat[7] == 42.0f);
+  }
+
+  SECTION("static extents") {
+    auto m = brica2::as_mdspan<float, brica2::dynamic_extent, 4>(b);
+    REQUIRE(m.static_extent(0) == brica2::dynamic_extent);
+    REQUIRE(m.static_extent(1) == 4);
+    REQUIRE(m(1, 2) == 6.0f);
+    REQUIRE_THROWS_AS(
+        (brica2::as_mdspan<float, brica2::dynamic_extent, 5>(b)),
+        brica2::fail_fast);
+  }
+
+  SECTION("type and rank are checked") {
+    REQUIRE_THROWS_AS(
+        (brica2::as_dynamic_mdspan<double, 2>(b)), brica2::fail_fast);
+    REQUIRE_THROWS_AS(
+        (brica2::as_dynamic_mdspan<float, 3>(b)), brica2::fail_fast);
+  }
+}
+
+TEST_CASE("mdspan slicing", "[mdspan]") {
+  auto b = brica2::empty<int>({3, 4});
+  auto flat = b.as_span<int>();
+  std::iota(flat.begin(), flat.end(), 0);
+  auto m = brica2::as_mdspan<int, 3, 4>(b);
+
+  SECTION("rows are unit stride") {
+    auto r = m.row(2);
+    REQUIRE(r.rank() == 1);
+    REQUIRE(r.static_extent(0) == 4);
+    REQUIRE(r.is_unit_stride());
+    REQUIRE(r.flat()[1] == 9);
+  }
+
+  SECTION("columns are strided") {
+    auto c = m.column(1);
+    REQUIRE(c.rank() == 1);
+    REQUIRE(c.extent(0) == 3);
+    REQUIRE(!c.is_unit_stride());
+    REQUIRE(!c.is_contiguous());
+    REQUIRE(c(2) == 9);
+    REQUIRE_THROWS_AS(c.flat(), brica2::fail_fast);
+  }
+
+  SECTION("slices") {
+    auto s = m.slice(1, 1, 3);
+    REQUIRE(s.extent(1) == 2);
+    REQUIRE(s(0, 0) == 1);
+    REQUIRE(s(2, 1) == 10);
+    REQUIRE(!s.is_contiguous());
+    REQUIRE(s.is_unit_stride());
+  }
+
+  SECTION("views over strided buffers") {
+    auto t = brica2::as_dynamic_mdspan<int, 2>(brica2::transpose(b));
+    REQUIRE(t.extent(0) == 4);
+    REQUIRE(t.stride(0) == 1);
+    REQUIRE(t(3, 2) == 11);
+  }
+}
@@ -0,0 +1,160 @@
+#include "catch.hpp"
+#include "brica2/buffer.hpp"
+#include "brica2/memory.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("pool resource recycles blocks", "[memory]") {
+  brica2::pool_resource pool(1024);
+
+  SECTION("size classes") {
+    void* p0 = pool.allocate(100, 8);
+    pool.deallocate(p0, 100, 8);
+    void* p1 = pool.allocate(128, 8);
+    CHECK(p0 == p1);
+    pool.deallocate(p1, 128, 8);
+
+    auto stats = pool.statistics();
+    CHECK(stats[1].block_size == 128);
+    CHECK(stats[1].hits == 1);
+    CHECK(stats[1].misses == 1);
+    CHECK(stats[1].bytes_live == 0);
+  }
+
+  SECTION("oversize requests bypass the pool") {
+    void* p = pool.allocate(4096, 8);
+    CHECK(pool.large_statistics().bytes_live == 4096);
+    pool.deallocate(p, 4096, 8);
+    CHECK(pool.large_statistics().bytes_live == 0);
+    CHECK(pool.large_statistics().misses == 1);
+  }
+
+  SECTION("blocks freed on another thread are reused") {
+    std::vector<void*> ps;
+    for (std::size_t i = 0; i < 64; ++i) ps.push_back(pool.allocate(64, 8));
+    std::thread t([&]() {
+      for (auto p : ps) pool.deallocate(p, 64, 8);
+    });
+    t.join();
+    for (std::size_t i = 0; i < 64; ++i) ps[i] = pool.allocate(64, 8);
+    auto stats = pool.statistics();
+    CHECK(stats[0].misses == 64);
+    CHECK(stats[0].hits == 64);
+    CHECK(stats[0].bytes_live == 64 * 64);
+    for (auto p : ps) pool.deallocate(p, 64, 8);
+  }
+}
+
+TEST_CASE("buffers allocate from a memory resource", "[memory]") {
+  brica2::pool_resource pool;
+
+  auto b0 = brica2::empty<float>({4, 4}, float(), 64, &pool);
+  CHECK(b0.request().resource == &pool);
+  CHECK(pool.statistics()[0].bytes_live == 64);
+
+  auto b1 = brica2::empty_like(b0);
+  CHECK(b1.request().resource == &pool);
+  CHECK(pool.statistics()[0].bytes_live == 128);
+
+  void* p = b0.data();
+  b0 = brica2::buffer();
+  auto b2 = brica2::zeros_like(b1);
+  CHECK(b2.data() == p);
+  CHECK(pool.statistics()[0].hits == 1);
+}
+
+TEST_CASE("huge page resource", "[memory]") {
+  constexpr std::size_t huge = brica2::huge_page_resource::huge_page;
+  brica2::huge_page_resource resource(true);
+
+  SECTION("large requests are mapped on huge page boundaries") {
+    void* p = resource.allocate(2 * huge + 1, 64);
+    CHECK(reinterpret_cast<std::uintptr_t>(p) % huge == 0);
+    static_cast<char*>(p)[2 * huge] = 1;
+
+    auto stats = resource.statistics();
+    CHECK(stats.mappings == 1);
+    CHECK(stats.bytes_mapped == 3 * huge);
+    CHECK(stats.bytes_huge <= stats.bytes_mapped);
+    CHECK(brica2::huge_page_bytes(p) <= stats.bytes_mapped);
+
+    resource.deallocate(p, 2 * huge + 1, 64);
+    CHECK(resource.statistics().mappings == 0);
+  }
+
+  SECTION("small requests go upstream") {
+    void* p = resource.allocate(1024, 64);
+    CHECK(resource.statistics().mappings == 0);
+    resource.deallocate(p, 1024, 64);
+  }
+
+  SECTION("buffers can select the resource") {
+    auto b = brica2::empty<float>({1024, 1024}, float(), 64, &resource);
+    CHECK(reinterpret_cast<std::uintptr_t>(b.data()) % huge == 0);
+    CHECK(resource.statistics().bytes_mapped == 2 * huge);
+  }
+}
+
+TEST_CASE("zeroed allocations", "[memory]") {
+  SECTION("recycled pool blocks are cleared") {
+    brica2::pool_resource pool;
+    auto b0 = brica2::fill<float>({16}, 1.0f, 64, &pool);
+    void* p = b0.data();
+    b0 = brica2::buffer();
+    auto b1 = brica2::zeros<float>({16}, float(), 64, &pool);
+    CHECK(b1.data() == p);
+    auto span = b1.as_span<float>();
+    CHECK(std::all_of(span.begin(), span.end(), [](float v) { return !v; }));
+  }
+
+  SECTION("large aligned blocks") {
+    brica2::malloc_resource resource;
+    std::size_t bytes = brica2::malloc_resource::large * 4;
+    for (int i = 0; i < 2; ++i) {
+      auto p = static_cast<char*>(resource.allocate_zeroed(bytes, 4096));
+      CHECK(reinterpret_cast<std::uintptr_t>(p) % 4096 == 0);
+      CHECK(std::all_of(p, p + bytes, [](char c) { return c == 0; }));
+      std::memset(p, 1, bytes);
+      resource.deallocate(p, bytes, 4096);
+    }
+  }
+
+  SECTION("zeros and zeros_like") {
+    auto b = brica2::zeros<double>({1024, 1024});
+    CHECK(b.request().format == "d");
+    CHECK(b.alignment() == brica2::default_alignment);
+    auto span = b.as_span<double>();
+    CHECK(std::all_of(span.begin(), span.end(), [](double v) { return !v; }));
+
+    auto c = brica2::zeros_like(brica2::fill<int>({3, 3}, 7));
+    auto cspan = c.as_span<int>();
+    CHECK(std::all_of(cspan.begin(), cspan.end(), [](int v) { return !v; }));
+  }
+}
+
+TEST_CASE("zeroing benchmark", "[.][benchmark]") {
+  for (std::size_t kb : {4, 256, 16 * 1024, 256 * 1024}) {
+    auto like = brica2::empty<float>({brica2::ssize_t(kb * 256)});
+    auto size = std::to_string(kb) + " KiB";
+
+    BENCHMARK("empty_like + fill, " + size) {
+      auto b = brica2::empty_like(like);
+      auto span = b.as_span<float>();
+      std::fill(span.begin(), span.end(), 0.0f);
+    }
+
+    BENCHMARK("zeros_like, " + size) { auto b = brica2::zeros_like(like); }
+
+    // Lazily zeroed pages are paid for on first write instead.
+    BENCHMARK("zeros_like + first write, " + size) {
+      auto b = brica2::zeros_like(like);
+      auto p = static_cast<volatile char*>(b.data());
+      for (std::size_t i = 0; i < b.size_bytes(); i += 4096) p[i] = 1;
+    }
+  }
+}
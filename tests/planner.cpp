@@ -0,0 +1,192 @@
+#include "catch.hpp"
+#include "brica2/planner.hpp"
+#include "brica2/executors.hpp"
+#include "brica2/scheduler.hpp"
+
+#include <algorithm>
+#include <vector>
+
+inline bool equal(const brica2::buffer& lhs, const brica2::buffer& rhs) {
+  if (!compatible(lhs, rhs)) return false;
+  auto lspan = lhs.as_span<float>();
+  auto rspan = rhs.as_span<float>();
+  return std::equal(lspan.begin(), lspan.end(), rspan.begin());
+}
+
+inline bool inside(const brica2::arena& a, const brica2::buffer& b) {
+  auto base = static_cast<const char*>(a.data());
+  auto p = static_cast<const char*>(b.data());
+  return base <= p && p + b.size_bytes() <= base + a.size();
+}
+
+TEST_CASE("memory plan", "[planner]") {
+  SECTION("overlapping lifetimes get distinct regions") {
+    brica2::memory_plan plan;
+    auto a = plan.add(100);
+    auto b = plan.add(100);
+    plan.solve();
+    CHECK(plan.offset(a) == 0);
+    CHECK(plan.offset(b) == 128);
+    CHECK(plan.size() == 228);
+  }
+
+  SECTION("disjoint lifetimes share regions") {
+    brica2::memory_plan plan;
+    auto a = plan.add(256, 64, 0, 1);
+    auto b = plan.add(128, 64, 2, 3);
+    auto c = plan.add(64, 64, 1, 2);
+    plan.solve();
+    CHECK(plan.offset(a) == 0);
+    CHECK(plan.offset(b) == 0);
+    CHECK(plan.offset(c) == 256);
+    CHECK(plan.size() == 320);
+    CHECK(plan.requested() == 448);
+  }
+
+  SECTION("alignment is respected") {
+    brica2::memory_plan plan;
+    auto a = plan.add(10, 64);
+    auto b = plan.add(10, 4096);
+    plan.solve();
+    CHECK(plan.offset(a) == 0);
+    CHECK(plan.offset(b) == 4096);
+    CHECK(plan.alignment() == 4096);
+  }
+}
+
+TEST_CASE("planned component outputs", "[planner]") {
+  std::string key = "default";
+  std::vector<brica2::ssize_t> shape({3});
+  auto value = brica2::with<float>({1, 2, 3}, shape);
+
+  brica2::functor_type constant = [key, value](const auto&, auto& outputs) {
+    auto src = value.as_span<float>();
+    auto dst = outputs[key].template as_span<float>();
+    std::copy(src.begin(), src.end(), dst.begin());
+  };
+  brica2::functor_type scale = [key](const auto& inputs, auto& outputs) {
+    auto src = inputs[key].template as_span<float>();
+    auto dst = outputs[key].template as_span<float>();
+    std::transform(src.begin(), src.end(), dst.begin(), [](float x) {
+      return 2 * x;
+    });
+  };
+
+  std::vector<brica2::component> cs{brica2::component(constant),
+                                    brica2::component(scale)};
+  cs[0].make_out_port<float>(key, shape);
+  cs[1].make_in_port<float>(key, shape);
+  cs[1].make_out_port<float>(key, shape);
+  brica2::connect({cs[0], key}, {cs[1], key});
+
+  auto a = brica2::plan_outputs(cs.begin(), cs.end());
+  // Two slots for the output read in the next step, one for the other.
+  CHECK(a.size() == 2 * 64 + 3 * sizeof(float));
+  CHECK(cs[1].get_in_port(key) == cs[0].get_out_port(key));
+  CHECK(a.data() == cs[0].get_out_port(key).get().data());
+
+  auto step = [&]() {
+    for (auto& c : cs) c.collect();
+    for (auto& c : cs) c.execute();
+    for (auto& c : cs) c.expose();
+  };
+
+  for (int i = 0; i < 4; ++i) {
+    step();
+    CHECK(inside(a, cs[0].get_output(key)));
+    CHECK(inside(a, cs[1].get_output(key)));
+    CHECK(inside(a, cs[1].get_input(key)));
+  }
+
+  auto doubled = brica2::with<float>({2, 4, 6}, shape);
+  CHECK(equal(cs[0].get_out_port(key).get(), value));
+  CHECK(equal(cs[1].get_out_port(key).get(), doubled));
+}
+
+TEST_CASE("planned outputs of a phased pipeline", "[planner]") {
+  std::vector<brica2::ssize_t> shape({16});
+  float count = 0;
+  std::vector<brica2::component> cs;
+  cs.emplace_back([&count](const auto&, auto& outputs) {
+    auto y = outputs["y"].template as_span<float>();
+    std::fill(y.begin(), y.end(), ++count);
+  });
+  for (int i = 0; i < 3; ++i) {
+    cs.emplace_back([](const auto& inputs, auto& outputs) {
+      auto x = inputs["x"].template as_span<float>();
+      auto y = outputs["y"].template as_span<float>();
+      std::transform(x.begin(), x.end(), y.begin(), [](float v) {
+        return v + 1;
+      });
+    });
+    cs.back().make_in_port<float>("x", shape);
+  }
+  for (auto& c : cs) c.make_out_port<float>("y", shape);
+  for (std::size_t i = 1; i < cs.size(); ++i) {
+    brica2::connect({cs[i - 1], "y"}, {cs[i], "x"});
+  }
+
+  // Each stage reads the previous one in the same step, so the first and
+  // third outputs are never live together; the last one is read outside.
+  auto a = brica2::plan_outputs(cs.begin(), cs.end(), {0, 1, 2, 3});
+  auto bytes = 16 * sizeof(float);
+  CHECK(a.size() == 3 * bytes);
+  CHECK(a.size() < 4 * bytes);
+  CHECK(cs[0].get_output("y").data() == cs[2].get_output("y").data());
+
+  brica2::serial exec;
+  brica2::multi_phase_scheduler s(exec);
+  for (std::size_t i = 0; i < cs.size(); ++i) s.add(cs[i], i);
+  for (int i = 0; i < 5; ++i) {
+    s.step();
+    auto y = cs[3].get_out_port("y").get().as_span<float>();
+    CHECK(y[0] == count + 3);
+    CHECK(y[15] == count + 3);
+    CHECK(inside(a, cs[3].get_out_port("y").get()));
+  }
+}
+
+TEST_CASE("planned outputs keep what delay lines read", "[planner]") {
+  std::vector<brica2::ssize_t> shape({4});
+  auto network = [&shape](float& count) {
+    std::vector<brica2::component> cs;
+    cs.emplace_back([&count](const auto&, auto& outputs) {
+      auto y = outputs["y"].template as_span<float>();
+      std::fill(y.begin(), y.end(), ++count);
+    });
+    cs.emplace_back([](const auto& inputs, auto& outputs) {
+      auto x = inputs["x"].template as_span<float>();
+      auto y = outputs["y"].template as_span<float>();
+      std::copy(x.begin(), x.end(), y.begin());
+    });
+    cs[0].make_out_port<float>("y", shape);
+    cs[1].make_in_port<float>("x", shape);
+    cs[1].make_out_port<float>("y", shape);
+    brica2::connect({cs[0], "y"}, {cs[1], "x"}, 3);
+    return cs;
+  };
+
+  float count = 0;
+  auto cs = network(count);
+  auto a = brica2::plan_outputs(cs.begin(), cs.end());
+  // Three past contents, the current one and the one being written.
+  CHECK(a.size() == 5 * 64 + 4 * sizeof(float));
+
+  float unplanned_count = 0;
+  auto unplanned = network(unplanned_count);
+
+  brica2::serial exec;
+  brica2::single_phase_scheduler s(exec), t(exec);
+  s.add(cs.begin(), cs.end());
+  t.add(unplanned.begin(), unplanned.end());
+  for (int i = 0; i < 8; ++i) {
+    s.step();
+    t.step();
+    auto expected = unplanned[1].get_out_port("y").get();
+    CHECK(equal(cs[1].get_out_port("y").get(), expected));
+  }
+  CHECK(cs[1].get_out_port("y").get().as_span<float>()[0] == 4);
+
+  brica2::dag_scheduler d(exec);
+  CHECK_THROWS_AS(d.add(cs[0]), brica2::fail_fast);
+}
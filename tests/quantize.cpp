@@ -0,0 +1,191 @@
+#include "catch.hpp"
+#include "brica2/quantize.hpp"
+#include "brica2/view.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+
+namespace {
+
+template <class F> void for_each_isa(F f) {
+  using brica2::simd::isa;
+  auto saved = brica2::simd::active_isa();
+  for (auto target : {isa::scalar, isa::sse2, isa::avx2, isa::avx512}) {
+    if (target > brica2::simd::detected_isa()) break;
+    brica2::simd::set_isa(target);
+    f(target);
+  }
+  brica2::simd::set_isa(saved);
+}
+
+brica2::buffer uniform(std::size_t n, float lo, float hi, unsigned seed) {
+  auto b = brica2::empty<float>({brica2::ssize_t(n)});
+  std::mt19937 engine(seed);
+  std::uniform_real_distribution<float> dist(lo, hi);
+  for (auto& v : b.as_span<float>()) v = dist(engine);
+  return b;
+}
+
+template <class T> brica2::buffer random_ints(std::size_t n, unsigned seed) {
+  auto b = brica2::empty<T>({brica2::ssize_t(n)});
+  std::mt19937 engine(seed);
+  std::uniform_int_distribution<int> dist(
+      std::numeric_limits<T>::min(), std::numeric_limits<T>::max());
+  for (auto& v : b.template as_span<T>()) v = T(dist(engine));
+  return b;
+}
+
+bool same_bytes(const brica2::buffer& a, const brica2::buffer& b) {
+  return a.size_bytes() == b.size_bytes() &&
+         std::memcmp(a.data(), b.data(), a.size_bytes()) == 0;
+}
+
+}  // namespace
+
+TEST_CASE("quantized buffers", "[quantize]") {
+  using brica2::quantization;
+
+  SECTION("calibration") {
+    auto a = brica2::with<float>({-1.0f, 0.5f, 3.0f}, {3});
+    auto q = brica2::calibrate<signed char>(a);
+    CHECK(q.scale == Approx(4.0 / 255));
+    CHECK(q.zero_point == -64);
+    CHECK(brica2::calibrate<short>(brica2::fill({4}, 0.0f)).scale == 1.0f);
+    // Zero is always representable, even for strictly positive data.
+    auto p = brica2::calibrate<signed char>(brica2::fill({4}, 2.0f));
+    CHECK(p.zero_point == -128);
+    CHECK_FALSE(quantization().quantized());
+  }
+
+  SECTION("round trip") {
+    auto a = uniform(1003, -2.0f, 5.0f, 1);
+    for_each_isa([&](brica2::simd::isa target) {
+      INFO(brica2::simd::isa_name(target));
+      auto q8 = brica2::quantize<signed char>(a);
+      auto q16 = brica2::quantize<short>(a);
+      CHECK(q8.request().format == 'b');
+      CHECK(q16.request().format == 'h');
+      auto d8 = brica2::dequantize(q8);
+      auto d16 = brica2::dequantize(q16);
+      auto x = a.as_span<float>();
+      auto y8 = d8.as_span<float>();
+      auto y16 = d16.as_span<float>();
+      float s8 = q8.request().quant.scale, s16 = q16.request().quant.scale;
+      std::size_t bad = 0;
+      for (std::size_t i = 0; i < a.size(); ++i) {
+        if (std::abs(x[i] - y8[i]) > s8 * 0.501f) ++bad;
+        if (std::abs(x[i] - y16[i]) > s16 * 0.501f) ++bad;
+      }
+      CHECK(bad == 0);
+    });
+  }
+
+  SECTION("saturation and NaN") {
+    auto a = brica2::with<float>(
+        {1e9f, -1e9f, std::nanf(""), 0.0f, 2.5f, 3.5f}, {6});
+    auto q = brica2::quantize<signed char>(a, quantization{1.0f, 10});
+    auto s = q.as_span<signed char>();
+    CHECK(s[0] == 127);
+    CHECK(s[1] == -128);
+    CHECK(s[2] == -128);
+    CHECK(s[3] == 10);
+    CHECK(s[4] == 12);  // ties round to even
+    CHECK(s[5] == 14);
+    CHECK_THROWS_AS(
+        brica2::quantize<signed char>(a, quantization{}), brica2::fail_fast);
+    CHECK_THROWS_AS(brica2::dequantize(a), brica2::fail_fast);
+  }
+
+  SECTION("vector kernels match the scalar ones") {
+    auto a = uniform(4099, -300.0f, 300.0f, 2);
+    quantization q{0.37f, 3};
+    brica2::simd::set_isa(brica2::simd::isa::scalar);
+    auto r8 = brica2::quantize<signed char>(a, q);
+    auto r16 = brica2::quantize<short>(a, q);
+    auto d8 = brica2::dequantize(r8);
+    auto d16 = brica2::dequantize(r16);
+    for_each_isa([&](brica2::simd::isa target) {
+      INFO(brica2::simd::isa_name(target));
+      auto q8 = brica2::quantize<signed char>(a, q);
+      auto q16 = brica2::quantize<short>(a, q);
+      CHECK(same_bytes(q8, r8));
+      CHECK(same_bytes(q16, r16));
+      auto e8 = brica2::dequantize(q8);
+      auto e16 = brica2::dequantize(q16);
+      CHECK(same_bytes(e8, d8));
+      CHECK(same_bytes(e16, d16));
+    });
+  }
+
+  SECTION("dot products") {
+    const std::size_t n = 70001;
+    auto a = random_ints<signed char>(n, 3);
+    auto b = random_ints<signed char>(n, 4);
+    a.request().quant = quantization{0.5f, -7};
+    b.request().quant = quantization{0.25f, 100};
+    auto x = a.as_span<signed char>();
+    auto y = b.as_span<signed char>();
+    std::int64_t expected = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      expected += std::int64_t(x[i] + 7) * (y[i] - 100);
+    }
+    for_each_isa([&](brica2::simd::isa target) {
+      INFO(brica2::simd::isa_name(target));
+      CHECK(brica2::dot(a, b) == 0.125 * expected);
+    });
+
+    auto c = random_ints<short>(1000, 5);
+    auto d = random_ints<short>(1000, 6);
+    c.request().quant = quantization{1.0f, 0};
+    d.request().quant = quantization{2.0f, 1};
+    std::int64_t wide = 0;
+    for (std::size_t i = 0; i < 1000; ++i) {
+      wide += std::int64_t(c.as_span<short>()[i]) *
+              (d.as_span<short>()[i] - 1);
+    }
+    CHECK(brica2::dot(c, d) == 2.0 * wide);
+    CHECK_THROWS_AS(brica2::dot(a, c), brica2::incompatible_exception);
+  }
+
+  SECTION("matrix-vector products") {
+    auto w = brica2::with<signed char>({1, 2, 3, -4, 5, -6}, {2, 3});
+    auto x = brica2::with<signed char>({3, 2, 1}, {3});
+    w.request().quant = quantization{0.5f, 0};
+    x.request().quant = quantization{2.0f, 1};
+    auto y = brica2::matvec(w, x);
+    REQUIRE(y.request().shape == brica2::extents({2}));
+    CHECK(y.as_span<float>()[0] == 1 * 2 + 2 * 1);
+    CHECK(y.as_span<float>()[1] == -4 * 2 + 5 * 1);
+    CHECK_THROWS_AS(
+        brica2::matvec(brica2::transpose(w), x),
+        brica2::incompatible_exception);
+  }
+
+  SECTION("parameters follow the data") {
+    auto q = brica2::quantize<signed char>(uniform(12, -1.0f, 1.0f, 7));
+    auto params = q.request().quant;
+    auto m = brica2::reshape(q, {3, 4});
+    CHECK(m.request().quant == params);
+    CHECK(brica2::select(m, 0, 1).request().quant == params);
+    CHECK(brica2::copy(m).request().quant == params);
+  }
+}
+
+TEST_CASE("quantized kernel throughput", "[.][benchmark]") {
+  const std::size_t n = 1 << 20;
+  auto wide = uniform(n, -1.0f, 1.0f, 8);
+  auto q = brica2::quantize<signed char>(wide);
+
+  for_each_isa([&](brica2::simd::isa target) {
+    std::string suffix = std::string(", ") + brica2::simd::isa_name(target);
+    BENCHMARK("quantize int8" + suffix) {
+      brica2::quantize<signed char>(wide, q.request().quant);
+    }
+    BENCHMARK("dequantize int8" + suffix) { brica2::dequantize(q); }
+    BENCHMARK("int8 dot" + suffix) { brica2::dot(q, q); }
+  });
+}
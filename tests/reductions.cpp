@@ -0,0 +1,211 @@
+#include "catch.hpp"
+#include "brica2/reductions.hpp"
+#include "brica2/view.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+template <class T> brica2::buffer random_buffer(std::size_t n, T lo, T hi) {
+  static std::mt19937 engine(7);
+  std::uniform_real_distribution<T> dist(lo, hi);
+  auto b = brica2::empty<T>({brica2::ssize_t(n)});
+  for (auto& v : b.template as_span<T>()) v = dist(engine);
+  return b;
+}
+
+template <class F> void for_each_isa(F f) {
+  using brica2::simd::isa;
+  auto saved = brica2::simd::active_isa();
+  for (auto target : {isa::scalar, isa::sse2, isa::avx2, isa::avx512}) {
+    if (target > brica2::simd::detected_isa()) break;
+    brica2::simd::set_isa(target);
+    f(target);
+  }
+  brica2::simd::set_isa(saved);
+}
+
+struct mode_guard {
+  explicit mode_guard(brica2::reduction_mode mode)
+      : saved(brica2::set_reduction_mode(mode)) {}
+  ~mode_guard() { brica2::set_reduction_mode(saved); }
+  brica2::reduction_mode saved;
+};
+
+template <class T> void check_reductions(double tolerance) {
+  const std::size_t n = 1000 + 13;
+  auto a = random_buffer<T>(n, -10, 10);
+  auto x = a.template as_span<T>();
+  long double sum = 0, l1 = 0, l2 = 0;
+  for (auto v : x) {
+    sum += v;
+    l1 += std::abs(v);
+    l2 += (long double)v * v;
+  }
+  auto peak = std::max_element(x.begin(), x.end()) - x.begin();
+
+  for (auto mode : {brica2::reduction_mode::fast,
+                    brica2::reduction_mode::deterministic}) {
+    mode_guard guard(mode);
+    for_each_isa([&](brica2::simd::isa target) {
+      INFO(brica2::simd::isa_name(target));
+      CHECK(std::abs(brica2::sum(a) - sum) <= tolerance * l1);
+      CHECK(std::abs(brica2::l1_norm(a) - l1) <= tolerance * l1);
+      CHECK(std::abs(brica2::l2_norm(a) - std::sqrt(l2)) <=
+            tolerance * std::sqrt(l2));
+      CHECK(brica2::amax(a) == x[peak]);
+      CHECK(brica2::amin(a) == *std::min_element(x.begin(), x.end()));
+      CHECK(brica2::argmax(a) == std::size_t(peak));
+    });
+  }
+}
+
+std::vector<double> bits_of_sums(const brica2::buffer& a) {
+  return {brica2::sum(a), brica2::l1_norm(a), brica2::l2_norm(a)};
+}
+
+template <class T> void check_deterministic() {
+  mode_guard guard(brica2::reduction_mode::deterministic);
+  for (std::size_t n : {5, 32, 1000, 4096 + 7}) {
+    auto a = random_buffer<T>(n, -1000, 1000);
+    std::vector<double> first;
+    for_each_isa([&](brica2::simd::isa target) {
+      INFO(brica2::simd::isa_name(target) << ", n = " << n);
+      auto sums = bits_of_sums(a);
+      if (first.empty()) first = sums;
+      CHECK(std::memcmp(sums.data(), first.data(), 3 * sizeof(double)) == 0);
+    });
+  }
+}
+
+}  // namespace
+
+TEST_CASE("reductions", "[reductions]") {
+  SECTION("float") { check_reductions<float>(1e-5); }
+  SECTION("double") { check_reductions<double>(1e-13); }
+
+  SECTION("deterministic mode gives identical bits on every isa") {
+    check_deterministic<float>();
+    check_deterministic<double>();
+  }
+
+  SECTION("integers") {
+    auto a = brica2::fill({1000}, (signed char)100);
+    CHECK(brica2::sum(a) == 100000.0);
+    CHECK(brica2::l1_norm(a) == 100000.0);
+    auto b = brica2::with<int>({3, -7, 7, 2}, {4});
+    CHECK(brica2::amax(b) == 7.0);
+    CHECK(brica2::amin(b) == -7.0);
+    CHECK(brica2::argmax(b) == 2);
+    CHECK(brica2::l2_norm(b) == std::sqrt(111.0));
+  }
+
+  SECTION("empty buffers") {
+    auto a = brica2::empty<float>({0});
+    CHECK(brica2::sum(a) == 0.0);
+    CHECK_THROWS_AS(brica2::amax(a), brica2::fail_fast);
+    CHECK_THROWS_AS(brica2::argmax(a), brica2::fail_fast);
+  }
+
+  SECTION("strided operands") {
+    auto m = brica2::with<float>({1, 2, 3, 4, 5, 6}, {2, 3});
+    auto column = brica2::select(m, 1, 2);
+    CHECK(brica2::sum(column) == 9.0);
+    CHECK(brica2::argmax(brica2::transpose(m)) == 5);
+  }
+}
+
+TEST_CASE("reductions along an axis", "[reductions]") {
+  std::vector<double> values(2 * 3 * 4);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    values[i] = double((i * 7) % 11) - 5;
+  }
+  auto a = brica2::empty<double>({2, 3, 4});
+  std::copy(values.begin(), values.end(), a.as_span<double>().begin());
+  auto at = [&](std::size_t i, std::size_t j, std::size_t k) {
+    return values[(i * 3 + j) * 4 + k];
+  };
+
+  for_each_isa([&](brica2::simd::isa target) {
+    INFO(brica2::simd::isa_name(target));
+
+    auto s0 = brica2::sum(a, 0);
+    CHECK(s0.request().shape == brica2::extents({1, 3, 4}));
+    auto s1 = brica2::amax(a, 1);
+    CHECK(s1.request().shape == brica2::extents({2, 1, 4}));
+    auto s2 = brica2::l2_norm(a, 2);
+    CHECK(s2.request().shape == brica2::extents({2, 3, 1}));
+    auto i1 = brica2::argmax(a, 1);
+    CHECK(i1.request().format ==
+          brica2::FormatDescriptor<brica2::ssize_t>::code());
+
+    for (std::size_t j = 0; j < 3; ++j) {
+      for (std::size_t k = 0; k < 4; ++k) {
+        CHECK(s0.as_span<double>()[j * 4 + k] == at(0, j, k) + at(1, j, k));
+      }
+    }
+    for (std::size_t i = 0; i < 2; ++i) {
+      for (std::size_t k = 0; k < 4; ++k) {
+        std::size_t best = 0;
+        for (std::size_t j = 1; j < 3; ++j) {
+          if (at(i, j, k) > at(i, best, k)) best = j;
+        }
+        CHECK(s1.as_span<double>()[i * 4 + k] == at(i, best, k));
+        CHECK(i1.as_span<brica2::ssize_t>()[i * 4 + k] ==
+              brica2::ssize_t(best));
+      }
+    }
+    for (std::size_t i = 0; i < 2; ++i) {
+      for (std::size_t j = 0; j < 3; ++j) {
+        double squares = 0;
+        for (std::size_t k = 0; k < 4; ++k) {
+          squares += at(i, j, k) * at(i, j, k);
+        }
+        CHECK(s2.as_span<double>()[i * 3 + j] ==
+              Approx(std::sqrt(squares)).epsilon(1e-15));
+      }
+    }
+  });
+
+  SECTION("integer sums come out as double") {
+    auto b = brica2::with<short>({1, 2, 3, 4, 5, 6}, {2, 3});
+    auto s = brica2::sum(b, 1);
+    CHECK(s.request().format == 'd');
+    CHECK(s.as_span<double>()[0] == 6.0);
+    CHECK(s.as_span<double>()[1] == 15.0);
+    auto m = brica2::amin(b, 0);
+    CHECK(m.request().format == 'h');
+    CHECK(m.as_span<short>()[2] == 3);
+  }
+
+  CHECK_THROWS_AS(brica2::sum(a, 3), brica2::fail_fast);
+}
+
+TEST_CASE("reduction throughput", "[.][benchmark]") {
+  const std::size_t n = 1 << 20;
+  auto a = random_buffer<float>(n, -4, 4);
+  double sink = 0;
+
+  for_each_isa([&](brica2::simd::isa target) {
+    std::string suffix = std::string(", ") + brica2::simd::isa_name(target);
+    for (auto mode : {brica2::reduction_mode::fast,
+                      brica2::reduction_mode::deterministic}) {
+      mode_guard guard(mode);
+      auto name =
+          mode == brica2::reduction_mode::fast ? "fast" : "deterministic";
+      BENCHMARK(std::string("sum, ") + name + suffix) {
+        sink += brica2::sum(a);
+      }
+      BENCHMARK(std::string("l2_norm, ") + name + suffix) {
+        sink += brica2::l2_norm(a);
+      }
+    }
+    BENCHMARK("amax" + suffix) { sink += brica2::amax(a); }
+    BENCHMARK("argmax" + suffix) { sink += brica2::argmax(a); }
+  });
+  CHECK(sink == sink);
+}
@@ -1,5 +1,10 @@
 #include "catch.hpp"
 #include "brica2/brica2.hpp"
+#include "brica2/events.hpp"
+
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 inline bool equal(const brica2::buffer& lhs, const brica2::buffer& rhs) {
   if (!compatible(lhs, rhs)) return false;
@@ -93,3 +98,347 @@ TEST_CASE(
     s.step();
   }
 }
+
+namespace {
+
+// A context component feeding a pure consumer and an impure one. Counts
+// how often each of them executes.
+struct skip_network {
+  explicit skip_network(bool pure_context)
+      : context([this](const auto&, auto& outputs) {
+          ++runs[0];
+          outputs["y"] = brica2::fill<float>({2}, 1);
+        }),
+        pure([this](const auto& inputs, auto& outputs) {
+          ++runs[1];
+          outputs["y"] = inputs["x"];
+        }),
+        impure([this](const auto& inputs, auto& outputs) {
+          ++runs[2];
+          outputs["y"] = inputs["x"];
+        }) {
+    context.make_out_port<float>("y", {2});
+    for (auto c : {&pure, &impure}) {
+      c->make_in_port<float>("x", {2});
+      c->make_out_port<float>("y", {2});
+      brica2::connect({context, "y"}, {*c, "x"});
+    }
+    context.set_pure(pure_context);
+    pure.set_pure();
+  }
+
+  int runs[3] = {0, 0, 0};
+  brica2::component context;
+  brica2::component pure;
+  brica2::component impure;
+};
+
+}  // namespace
+
+TEST_CASE("pure components skip steps without new inputs", "[scheduler]") {
+  brica2::serial exec;
+
+  SECTION("ports count generations") {
+    brica2::port p({2}, float());
+    auto g = p.generation();
+    p.set(brica2::fill<float>({2}, 1));
+    CHECK(p.generation() != g);
+    CHECK(brica2::port({2}, float()).generation() != p.generation());
+  }
+
+  SECTION("single phase") {
+    skip_network n(true);
+    brica2::single_phase_scheduler s(exec);
+    s.add(n.context);
+    s.add(n.pure);
+    s.add(n.impure);
+    for (int i = 0; i < 5; ++i) s.step();
+    CHECK(n.runs[0] == 1);
+    CHECK(n.runs[1] == 2);
+    CHECK(n.runs[2] == 5);
+    CHECK(n.pure.get_output("y").as_span<float>()[1] == 1);
+    CHECK(s.get_stats().run == 8);
+    CHECK(s.get_stats().skipped == 7);
+    CHECK(s.get_stats().skip_rate() == Approx(7.0 / 15));
+  }
+
+  SECTION("an impure producer keeps its consumers running") {
+    skip_network n(false);
+    brica2::multi_phase_scheduler s(exec);
+    s.add(n.context, 0);
+    s.add(n.pure, 1);
+    for (int i = 0; i < 5; ++i) s.step();
+    CHECK(n.runs[1] == 5);
+    CHECK(s.get_stats().skipped == 0);
+    s.reset_stats();
+    CHECK(s.get_stats().run == 0);
+  }
+
+  SECTION("virtual time") {
+    skip_network n(true);
+    brica2::virtual_time_scheduler s(exec);
+    brica2::timing_t t{0, 1, 0};
+    s.add(n.context, t);
+    s.add(n.pure, t);
+    s.add(n.impure, t);
+    for (int i = 0; i < 6; ++i) s.step();
+    CHECK(n.runs[0] == 1);
+    CHECK(n.runs[1] == 2);
+    CHECK(n.runs[2] == 6);
+    CHECK(n.pure.get_out_port("y").get().as_span<float>()[0] == 1);
+  }
+
+  SECTION("sources of delay lines keep publishing") {
+    brica2::port input({1}, float());
+    brica2::component relay([](const auto& inputs, auto& outputs) {
+      outputs["y"] = inputs["x"];
+    });
+    relay.set_pure();
+    relay.make_in_port<float>("x", {1});
+    relay.make_out_port<float>("y", {1});
+    float seen = -1;
+    brica2::component sink([&](const auto& inputs, auto&) {
+      seen = inputs["x"].template as_span<float>()[0];
+    });
+    sink.make_in_port<float>("x", {1});
+    brica2::connect(input, relay.get_in_port("x"));
+    brica2::connect({relay, "y"}, {sink, "x"}, 2);
+
+    brica2::single_phase_scheduler s(exec);
+    s.add(relay);
+    s.add(sink);
+    for (int i = 1; i <= 6; ++i) {
+      if (i <= 3) input.set(brica2::fill({1}, float(i)));
+      s.step();
+    }
+    CHECK(seen == 3);
+    CHECK(s.get_stats().skipped == 0);
+  }
+}
+
+TEST_CASE("event-driven scheduling", "[scheduler]") {
+  brica2::serial exec;
+  int runs[3] = {0, 0, 0};
+  std::vector<brica2::component> chain;
+  for (int i = 0; i < 3; ++i) {
+    chain.emplace_back([&runs, i](const auto& inputs, auto& outputs) {
+      ++runs[i];
+      outputs["y"] = i == 0 ? brica2::fill<float>({2}, 1) : inputs["x"];
+    });
+    chain.back().make_out_port<float>("y", {2});
+    if (i > 0) chain.back().make_in_port<float>("x", {2});
+  }
+  brica2::event_driven_scheduler s(exec);
+
+  SECTION("activity follows the connections") {
+    brica2::connect({chain[0], "y"}, {chain[1], "x"});
+    brica2::connect({chain[1], "y"}, {chain[2], "x"});
+    s.add(chain.begin(), chain.end());
+    std::vector<std::size_t> active;
+    for (int i = 0; i < 4; ++i) {
+      s.step();
+      active.push_back(s.active_count());
+    }
+    CHECK(active == std::vector<std::size_t>({3, 2, 1, 0}));
+    CHECK(chain[2].get_output("y").as_span<float>()[0] == 1);
+
+    s.wake(chain[0]);
+    for (int i = 0; i < 4; ++i) s.step();
+    CHECK(runs[0] == 2);
+    CHECK(runs[2] == 4);
+    CHECK(s.get_stats().run == 9);
+    CHECK(s.get_stats().skipped == 15);
+  }
+
+  SECTION("delays and persistent components") {
+    brica2::connect({chain[0], "y"}, {chain[1], "x"}, 2);
+    s.add(chain[0], true);
+    s.add(chain[1]);
+    for (int i = 0; i < 3; ++i) s.step();
+    CHECK(runs[0] == 3);
+    CHECK(runs[1] == 1);
+    s.step();
+    CHECK(runs[1] == 2);
+  }
+
+  SECTION("delay lines count steps, not runs") {
+    brica2::connect({chain[0], "y"}, {chain[1], "x"}, 2);
+    s.add(chain[0]);
+    s.add(chain[1]);
+    for (int i = 0; i < 4; ++i) s.step();
+    CHECK(runs[0] == 1);
+    CHECK(runs[1] == 2);
+    CHECK(chain[1].get_output("y").as_span<float>()[0] == 1);
+  }
+
+  SECTION("empty event outputs wake nobody") {
+    int fired = 0;
+    int heard = 0;
+    brica2::component spikes([&](const auto&, auto& outputs) {
+      auto& out = outputs["s"];
+      if (++fired % 3 == 0) brica2::add_event(out, 1);
+    });
+    brica2::component listener([&](const auto&, auto&) { ++heard; });
+    spikes.make_out_port("s", brica2::make_events(4));
+    listener.make_in_port("s", brica2::make_events(4));
+    brica2::connect({spikes, "s"}, {listener, "s"});
+    s.add(spikes, true);
+    s.add(listener);
+    for (int i = 0; i < 7; ++i) s.step();
+    CHECK(fired == 7);
+    CHECK(heard == 3);
+  }
+
+  SECTION("outputs left unexposed wake nobody") {
+    int fired = 0;
+    int heard = 0;
+    brica2::component source([&](const auto&, auto& outputs) {
+      if (++fired % 2 == 0) outputs["y"] = brica2::buffer();
+    });
+    brica2::component listener([&](const auto&, auto&) { ++heard; });
+    source.make_out_port<float>("y", {2});
+    listener.make_in_port<float>("x", {2});
+    brica2::connect({source, "y"}, {listener, "x"});
+    s.add(source, true);
+    s.add(listener);
+    for (int i = 0; i < 6; ++i) s.step();
+    CHECK(fired == 6);
+    // The first step, and those after the three exposing ones.
+    CHECK(heard == 4);
+  }
+}
+
+namespace {
+
+// A counter feeding a chain of two delays, whose ends meet again in a sink
+// that records what it sees every step.
+// With buffering, outputs are written into reused buffers.
+template <class Scheduler>
+std::vector<float> run_diamond(
+    int steps, std::size_t threads = 4, std::size_t buffering = 0) {
+  brica2::parallel exec(threads);
+  Scheduler s(exec);
+  float count = 0;
+  std::vector<float> seen;
+  brica2::functor_type identity = [](const auto& inputs, auto& outputs) {
+    auto x = inputs["x"].template as_span<float>();
+    outputs["y"].template as_span<float>()[0] = x[0];
+  };
+  brica2::component counter([&count](const auto&, auto& outputs) {
+    outputs["y"].template as_span<float>()[0] = ++count;
+  });
+  brica2::component a(identity), b(identity);
+  brica2::component sink([&seen](const auto& inputs, auto&) {
+    seen.push_back(inputs["p"].template as_span<float>()[0]);
+    seen.push_back(inputs["q"].template as_span<float>()[0]);
+  });
+  counter.make_out_port<float>("y", {1});
+  for (brica2::component* c : {&a, &b}) {
+    c->make_in_port<float>("x", {1});
+    c->make_out_port<float>("y", {1});
+  }
+  sink.make_in_port<float>("p", {1});
+  sink.make_in_port<float>("q", {1});
+  for (brica2::component* c : {&counter, &a, &b}) c->set_buffering(buffering);
+  brica2::connect({counter, "y"}, {a, "x"});
+  brica2::connect({a, "y"}, {b, "x"});
+  brica2::connect({counter, "y"}, {sink, "p"});
+  brica2::connect({b, "y"}, {sink, "q"});
+  s.add(counter);
+  s.add(a);
+  s.add(b);
+  s.add(sink);
+  for (int i = 0; i < steps; ++i) s.step();
+  return seen;
+}
+
+}  // namespace
+
+TEST_CASE("dependency-driven scheduling", "[scheduler]") {
+  SECTION("steps compute what the single phase scheduler does") {
+    auto expected = run_diamond<brica2::single_phase_scheduler>(20);
+    CHECK(run_diamond<brica2::dag_scheduler>(20) == expected);
+    CHECK(expected[2 * 19] == 19);
+    CHECK(expected[2 * 19 + 1] == 17);
+  }
+
+  SECTION("buffers are reused only once their readers are done") {
+    auto expected = run_diamond<brica2::single_phase_scheduler>(500);
+    CHECK(run_diamond<brica2::dag_scheduler>(500, 8, 2) == expected);
+    CHECK(run_diamond<brica2::dag_scheduler>(500, 8, 4) == expected);
+  }
+
+  SECTION("exceptions reach the caller") {
+    int runs = 0;
+    brica2::component source([](const auto&, auto&) {});
+    brica2::component failing([&runs](const auto&, auto&) {
+      if (++runs == 3) throw std::runtime_error("failing");
+    });
+    source.make_out_port<float>("y", {1});
+    failing.make_in_port<float>("x", {1});
+    brica2::connect({source, "y"}, {failing, "x"});
+    brica2::parallel exec(4);
+    brica2::dag_scheduler s(exec);
+    s.add(source);
+    s.add(failing);
+    CHECK_THROWS_AS(s.run(10), std::runtime_error);
+    CHECK(runs == 3);
+  }
+
+  SECTION("runs without barriers and reports") {
+    std::vector<brica2::component> chain;
+    float count = 0;
+    for (int i = 0; i < 4; ++i) {
+      chain.emplace_back([i, &count](const auto& inputs, auto& outputs) {
+        auto y = outputs["y"].template as_span<float>();
+        y[0] = i == 0 ? ++count : inputs["x"].template as_span<float>()[0];
+      });
+      chain.back().make_out_port<float>("y", {1});
+      if (i > 0) {
+        chain.back().make_in_port<float>("x", {1});
+        brica2::connect({chain[i - 1], "y"}, {chain[i], "x"});
+      }
+    }
+    brica2::parallel exec(4);
+    brica2::dag_scheduler s(exec);
+    s.add(chain.begin(), chain.end());
+    s.run(50);
+    auto& stats = s.get_stats();
+    CHECK(stats.steps == 50);
+    CHECK(stats.tasks == 2 * 4 * 50);
+    CHECK(stats.span <= stats.work);
+    CHECK(stats.available_parallelism() >= 1);
+    CHECK(chain[3].get_out_port("y").get().as_span<float>()[0] == 47);
+
+    brica2::serial inline_exec;
+    brica2::dag_scheduler t(inline_exec);
+    t.add(chain.begin(), chain.end());
+    t.run(1000);
+    CHECK(t.get_stats().tasks == 2 * 4 * 1000);
+  }
+
+  SECTION("unsafe components run on the calling thread") {
+    struct unsafe : brica2::component {
+      using brica2::component::component;
+      bool thread_safe() const override { return false; }
+    };
+    std::vector<std::thread::id> threads;
+    brica2::component source([](const auto&, auto& outputs) {
+      outputs["y"] = brica2::fill({1}, 1.0f);
+    });
+    unsafe sink([&](const auto&, auto&) {
+      threads.push_back(std::this_thread::get_id());
+    });
+    source.make_out_port<float>("y", {1});
+    sink.make_in_port<float>("x", {1});
+    brica2::connect({source, "y"}, {sink, "x"});
+    brica2::parallel exec(4);
+    brica2::dag_scheduler s(exec);
+    s.add(source);
+    s.add(sink);
+    s.run(20);
+    REQUIRE(threads.size() == 20);
+    for (auto id : threads) CHECK(id == std::this_thread::get_id());
+    CHECK(sink.get_input("x").as_span<float>()[0] == 1);
+  }
+}
@@ -0,0 +1,138 @@
+#include "catch.hpp"
+#include "brica2/brica2.hpp"
+#include "brica2/static_component.hpp"
+
+#include <algorithm>
+#include <string>
+
+namespace {
+
+using vec3 = brica2::static_port<float, 3>;
+
+struct scale {
+  float factor;
+  void operator()(
+      brica2::span<const float> x, brica2::span<float> y) const {
+    for (brica2::ssize_t i = 0; i < x.size(); ++i) y[i] = factor * x[i];
+  }
+};
+
+}  // namespace
+
+TEST_CASE("statically typed components", "[static_component]") {
+  using brica2::In;
+  using brica2::Out;
+
+  SECTION("ports follow the template parameters") {
+    auto f = [](brica2::span<const float> a,
+                brica2::span<const int> b,
+                brica2::span<double> c) {
+      CHECK(a.size() == 6);
+      CHECK(b.size() == 4);
+      std::fill(c.begin(), c.end(), 1.0);
+    };
+    auto c = brica2::make_static_component<
+        In<brica2::static_port<float, 2, 3>, brica2::static_port<int, 4>>,
+        Out<brica2::static_port<double, 5>>>(f);
+    static_assert(decltype(c)::in_count == 2, "two inputs");
+    CHECK(c.in_port<0>().get().request().shape == brica2::extents({2, 3}));
+    CHECK(c.in_port<1>().get().request().format == 'i');
+    CHECK(c.out_port<0>().get().request().format == 'd');
+    c.collect();
+    c.execute();
+    c.expose();
+    CHECK(c.out_port<0>().get().as_span<double>()[4] == 1.0);
+  }
+
+  SECTION("interoperates with basic components and schedulers") {
+    auto value = brica2::with<float>({1, 2, 3}, {3});
+    brica2::component source([value](const auto&, auto& outputs) {
+      outputs["x"] = value;
+    });
+    std::vector<float> seen;
+    brica2::component sink([&](const auto& inputs, auto&) {
+      auto s = inputs["y"].template as_span<float>();
+      seen.assign(s.begin(), s.end());
+    });
+    source.make_out_port<float>("x", {3});
+    sink.make_in_port<float>("y", {3});
+    brica2::static_component<scale, In<vec3>, Out<vec3>> doubler(scale{2});
+
+    brica2::connect(source.get_out_port("x"), doubler.in_port<0>());
+    brica2::connect(doubler.out_port<0>(), sink.get_in_port("y"));
+    auto wrong = brica2::static_component<scale, In<vec3>, Out<vec3>>(
+        scale{1});
+    brica2::port dense4({4}, float());
+    CHECK_THROWS_AS(
+        brica2::connect(dense4, wrong.in_port<0>()),
+        brica2::incompatible_exception);
+
+    brica2::serial exec;
+    brica2::single_phase_scheduler s(exec);
+    s.add(source);
+    s.add(doubler);
+    s.add(sink);
+    for (int i = 0; i < 3; ++i) s.step();
+    CHECK(seen == std::vector<float>({2, 4, 6}));
+  }
+
+  SECTION("strided inputs are packed") {
+    auto image = brica2::with<float>({1, 2, 3, 4, 5, 6}, {3, 2});
+    brica2::static_component<scale, In<vec3>, Out<vec3>> c(scale{1});
+    c.in_port<0>().set(brica2::select(image, 1, 1));
+    c.collect();
+    c.execute();
+    c.expose();
+    CHECK(c.output<0>().as_span<float>()[2] == 6);
+  }
+
+  SECTION("inputs set without connect() are checked") {
+    brica2::static_component<scale, In<vec3>, Out<vec3>> c(scale{1});
+    c.in_port<0>().set(brica2::fill({4}, 1.0f));
+    CHECK_THROWS_AS(c.collect(), brica2::incompatible_exception);
+    c.in_port<0>() = brica2::port({3}, int());
+    CHECK_THROWS_AS(c.collect(), brica2::incompatible_exception);
+  }
+
+  SECTION("outputs are recycled") {
+    brica2::static_component<scale, In<vec3>, Out<vec3>> c(scale{1});
+    void* addresses[4];
+    for (auto& a : addresses) {
+      c.collect();
+      c.execute();
+      c.expose();
+      a = c.output<0>().data();
+    }
+    CHECK(addresses[1] == addresses[3]);
+    CHECK(addresses[2] != addresses[3]);
+  }
+}
+
+TEST_CASE("static component step cost", "[.][benchmark]") {
+  using brica2::In;
+  using brica2::Out;
+  const int steps = 100000;
+
+  brica2::static_component<scale, In<vec3>, Out<vec3>> fixed(scale{2});
+  BENCHMARK("static_component") {
+    for (int i = 0; i < steps; ++i) {
+      fixed.collect();
+      fixed.execute();
+      fixed.expose();
+    }
+  }
+
+  brica2::component dynamic([](const auto& inputs, auto& outputs) {
+    scale{2}(inputs["x"].template as_span<const float>(),
+             outputs["y"].template as_span<float>());
+  });
+  dynamic.make_in_port<float>("x", {3});
+  dynamic.make_out_port<float>("y", {3});
+  BENCHMARK("basic_component") {
+    for (int i = 0; i < steps; ++i) {
+      dynamic.collect();
+      dynamic.execute();
+      dynamic.expose();
+    }
+  }
+}